@@ -19,9 +19,15 @@
 // limitations under the License.
 //
 ///////////////////////////////////////////////////////////////////////////
+#include "Adam.hpp"
 #include "Common.hpp"
+#include "CrossEntropy.hpp"
 #include "DataLoader.hpp"
+#include "FixedLinear.hpp"
+#include "FixedReLU.hpp"
 #include "GlobalState.hpp"
+#include "Identity.hpp"
+#include "InferenceServer.hpp"
 #include "Linear.hpp"
 #include "MSE.hpp"
 #include "ReLU.hpp"
@@ -29,6 +35,8 @@
 #include "Softmax.hpp"
 #include "Trainer.hpp"
 
+#include <chrono>
+
 using namespace DeepLearningFramework;
 
 int main() {
@@ -42,22 +50,36 @@ int main() {
   // train mode: SYNC | ASYNC
   globalTrainMode() = SYNC;
 
+  // precision mode: FP32 | MIXED_BF16
+  globalPrecisionMode() = FP32;
+
+  // seed of weight initialization, dropout masks and shuffling
+  // globalSeed() = 42;
+
   // iris
   std::vector<int> layers_size = {4, 10, 10, 3};
 
   // uniform_sample_size_per_part
   // std::vector<int> layers_size = {2, 10, 10, 2};
 
+  constexpr auto batch_size = 64;
+  constexpr auto feature_dim = 4;
+
   initialize(layers_size);
   /* Model creation */
+  // makeLinear/makeReLU pick the fixed-size FixedLinear/FixedReLU
+  // specialization for batch_size when the layer shape is compiled in.
   std::vector<Module *> layers;
   const int layers_num = layers_size.size();
   for (int i = 1; i < layers_num; ++i) {
-    layers.emplace_back(new Layers::Linear(layers_size[i - 1], layers_size[i]));
+    layers.emplace_back(
+        Layers::makeLinear<batch_size>(layers_size[i - 1], layers_size[i]));
+    // CrossEntropy takes raw logits, so the last layer has no Softmax.
+    // With Losses::MSE, use Activations::Softmax as the last activation.
     if (i == layers_num - 1)
-      layers.emplace_back(new Activations::Softmax());
+      layers.emplace_back(new Activations::Identity());
     else {
-      layers.emplace_back(new Activations::ReLU());
+      layers.emplace_back(Activations::makeReLU<batch_size>(layers_size[i]));
     }
   }
 
@@ -65,19 +87,31 @@ int main() {
   Eigen::MatrixXf y_train, X_train, y_test, X_test;
   std::string data_path = "../data/iris/";
   // std::string data_path = "../data/uniform_sample_size_per_part/";
+  // binary part files load without parsing, convert the CSV parts once:
+  // DataLoader::convert(data_path, "../data/iris_bin/");
   DataLoader::load(data_path, X_train, y_train, X_test, y_test);
 
-  Losses::MSE mseLoss;
+  // Losses::MSE loss;
+  Losses::CrossEntropy loss;
 
-  Sequential model(layers, mseLoss);
+  Sequential model(layers, loss);
   // model.printDescription();
 
   /* Train params */
   float lr = 0.001f;
   model.setLR(lr);
+
+  // optimizer: plain SGD by default, or SGD with momentum | Adam | AdamW
+  // Optimizers::Adam optimizer(lr);
+  // model.setOptimizer(optimizer);
+
+  // update once every K batches with gradients accumulated over K batches
+  // model.setGradientAccumulation(4);
   uint32_t epochs = 200, step = 1;
-  constexpr auto batch_size = 64;
-  constexpr auto feature_dim = 4;
+  // score accuracy on a snapshot of the weights while the next epoch trains,
+  // over a random half of the samples
+  // globalEvaluationOptions().async = true;
+  // globalEvaluationOptions().sample_fraction = 0.5f;
 
   // number of train and test samples
   std::vector<float> train_acc, test_acc;
@@ -86,6 +120,37 @@ int main() {
   Trainer::trainModel<batch_size, feature_dim>(train_acc, test_acc, model,
                                                epochs, y_train, X_train, y_test,
                                                X_test, step);
+  // or stream batches from the part files without holding the dataset:
+  // BatchStream train_stream(data_path, "train", batch_size);
+  // BatchStream test_stream(data_path, "test", batch_size, false, false);
+  // Trainer::trainModel(train_acc, test_acc, model, epochs, train_stream,
+  //                     test_stream, step);
+
+  Log() << "Saved activation memory: " << model.getSavedActivationBytes()
+        << " bytes";
+
+  // fp32 vs int8 inference on the test set
+  auto evaluate = [&](const std::string &name) {
+    Eigen::MatrixXf y_pred = X_test;
+    auto start = std::chrono::steady_clock::now();
+    model.forward(y_pred, "predict");
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    float accuracy = 0.f;
+    Metrics::accuracy(accuracy, y_test, y_pred);
+    Log() << name << " inference, test accuracy: " << accuracy
+          << ", time: " << elapsed.count() << " ms";
+  };
+  evaluate("fp32");
+  model.quantize(X_train.topRows(batch_size));
+  evaluate("int8");
+
+  // export for inference processes, which load it with MappedModel
+  // model.save("iris.model");
+
+  // serve predictions on 127.0.0.1:5555, one CSV sample per line
+  // InferenceServer server(model, feature_dim);
+  // server.serve();
 
   finalize();
 }
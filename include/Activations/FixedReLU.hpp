@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * FixedReLU activation class definition
+ */
+
+#pragma once
+
+#include "ReLU.hpp"
+
+namespace DeepLearningFramework {
+namespace Activations {
+/**
+ * Activation class: FixedReLU.
+ *
+ * ReLU specialized at compile time for batches of B rows and N columns, so
+ * the mask loops have constant trip counts and unroll. Any other shape falls
+ * back to ReLU.
+ *
+ * forward: output = input if input > 0, else 0
+ * backward: output = 1*input if forward input was >= 0, else 0
+ */
+template <int B, int N> class FixedReLU : public ReLU {
+public:
+  FixedReLU() : ReLU() {}
+  ~FixedReLU() = default;
+
+  void forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override {
+    if (x.rows() != B || x.cols() != N) {
+      ReLU::forward(out, x);
+      return;
+    }
+    _mask.resize(kWords);
+    out.resize(B, N);
+
+    const float *in = x.data();
+    float *result = out.data();
+    for (int word = 0; word < kWords; ++word) {
+      uint64_t bits = 0;
+      for (int j = 0; j < 64 && word * 64 + j < kSize; ++j) {
+        const float value = in[word * 64 + j];
+        bits |= static_cast<uint64_t>(!(value < 0.f)) << j;
+        result[word * 64 + j] = value < 0.f ? 0.f : value;
+      }
+      _mask[word] = bits;
+    }
+  }
+
+  void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override {
+    if (dout.rows() != B || dout.cols() != N) {
+      ReLU::backward(din, dout);
+      return;
+    }
+    din.resize(B, N);
+
+    const float *grad = dout.data();
+    float *result = din.data();
+    for (int word = 0; word < kWords; ++word) {
+      const uint64_t bits = _mask[word];
+      for (int j = 0; j < 64 && word * 64 + j < kSize; ++j) {
+        result[word * 64 + j] = ((bits >> j) & 1u) ? grad[word * 64 + j] : 0.f;
+      }
+    }
+  }
+
+private:
+  static constexpr int kSize = B * N;
+  static constexpr int kWords = (kSize + 63) / 64;
+};
+
+template <int B, int N> Module *newFixedReLU() {
+  return new FixedReLU<B, N>();
+}
+
+/**
+ * Create a ReLU activation, specialized as FixedReLU<B, size> when size is
+ * one of the compiled-in widths.
+ *
+ * @param[in] size width of the activation
+ */
+template <int B> Module *makeReLU(int size) {
+  struct Entry {
+    int size;
+    Module *(*make)();
+  };
+  static const Entry table[] = {
+      {10, &newFixedReLU<B, 10>},
+  };
+  for (const Entry &entry : table) {
+    if (entry.size == size) {
+      return entry.make();
+    }
+  }
+  return new ReLU();
+}
+}; // namespace Activations
+}; // namespace DeepLearningFramework
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Identity activation class definition
+ */
+
+#pragma once
+
+#include "Module.hpp"
+
+#include <iostream>
+
+namespace DeepLearningFramework {
+namespace Activations {
+/**
+ * Activation class: Identity.
+ *
+ * Placeholder activation for layers whose output is consumed as raw logits
+ * (e.g. by Losses::CrossEntropy). Keeps the Linear/activation pairing that
+ * pipeline parallelism relies on.
+ *
+ * forward: output = input
+ * backward: output = input
+ */
+class Identity : public Module {
+public:
+  Identity();
+  ~Identity() = default;
+
+  /**
+   * Forward pass of the Identity activation function.
+   *
+   * @param[out] out x
+   * @param[in] x Values on which to apply Identity
+   */
+  void forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  /**
+   * Backward pass of the Identity activation function.
+   *
+   * @param[out] din dout
+   * @param[in] dout Values on which to apply backpropagation
+   */
+  void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override;
+
+  /* Print description of Identity activation class */
+  void printDescription() override;
+
+  /* Override getParametersCount */
+  int64_t getParametersCount() override { return 0; }
+
+  std::string getName();
+
+private:
+  std::string _type = "Activation";
+  std::string _name = "Identity";
+};
+}; // namespace Activations
+}; // namespace DeepLearningFramework
@@ -27,15 +27,18 @@
 
 #include "Module.hpp"
 
+#include <cstdint>
 #include <iostream>
+#include <vector>
 
 namespace DeepLearningFramework {
 namespace Activations {
 /**
  * Activation class: ReLU.
  *
- * forward: output = input if input > 0, else 0
- * backward: output = 1*input if forward input was > 0, else 0
+ * forward: output = input if input > 0, else 0, sign of input saved as a
+ * packed bitmask (1 bit per element) for backward pass
+ * backward: output = 1*input if forward input was >= 0, else 0
  */
 class ReLU : public Module {
 public:
@@ -58,21 +61,31 @@ public:
    */
   void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override;
 
+  /**
+   * Inference pass of the ReLU activation function, input is not saved.
+   *
+   * @param[out] out input if input > 0, else 0
+   * @param[in] x Values on which to apply ReLU
+   */
+  void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
   /* Print description of ReLU activation class */
   void printDescription() override;
 
-  /* Override set learning rate */
-  void setLR(float lr) override {}
-
   /* Override getParametersCount */
-  uint32_t getParametersCount() override { return 0; }
+  int64_t getParametersCount() override { return 0; }
 
   std::string getName();
 
-private:
+  size_t getSavedActivationBytes() override {
+    return _mask.size() * sizeof(uint64_t);
+  }
+
+protected:
   std::string _type = "Activation";
   std::string _name = "ReLU";
-  Eigen::MatrixXf _forward_input;
+  // bit i of word i / 64 is set when forward input i was not negative
+  std::vector<uint64_t> _mask;
 };
 }; // namespace Activations
 }; // namespace DeepLearningFramework
@@ -34,9 +34,10 @@ namespace Activations {
 /**
  * Activation class: Softmax.
  *
- * forward: output = exp(IN_i)/exp(sum(IN)), input saved for backward pass
- * backward: output = [Softmax(forward_input) * (1 - Softmax(forward_input))] *
- * input
+ * forward: output = exp(IN_i - max(IN) - log(sum(exp(IN - max(IN))))),
+ * output saved for backward pass
+ * backward: output = Softmax(forward_input) *
+ * (input - rowsum(input * Softmax(forward_input)))
  */
 class Softmax : public Module {
 public:
@@ -46,7 +47,7 @@ public:
   /**
    * Forward pass of the Softmax activation function.
    *
-   * @param[out] out exp(IN_i)/exp(sum(IN)), input saved for backward pass
+   * @param[out] out exp(IN_i)/sum(exp(IN)), output saved for backward pass
    * @param[in] x Values on which to apply Softmax
    */
   void forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
@@ -54,35 +55,46 @@ public:
   /**
    * Backward pass of the Softmax activation function.
    *
-   * @param[out] din [Softmax(forward_input) * (I - Softmax(forward_input))] *
-   * input
+   * @param[out] din Softmax(forward_input) *
+   * (input - rowsum(input * Softmax(forward_input)))
    * @param[in] dout Values on which to apply backpropagation
    */
   void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override;
 
+  /**
+   * Inference pass of the Softmax activation function, output is not saved.
+   *
+   * @param[out] out exp(IN_i)/sum(exp(IN))
+   * @param[in] x Values on which to apply Softmax
+   */
+  void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
   /* Print description of Softmax activation class */
   void printDescription() override;
 
-  /* Override set learning rate */
-  void setLR(float lr) override {}
-
   /* Override getParametersCount */
-  uint32_t getParametersCount() override { return 0; }
+  int64_t getParametersCount() override { return 0; }
 
   std::string getName();
 
+  size_t getSavedActivationBytes() override {
+    return _forward_input_with_softmax_applied.size() * sizeof(float);
+  }
+
 private:
   /**
-   * Softmax equation implementation.
+   * Softmax equation implementation, numerically stable log-sum-exp form.
    *
    * @param[in] x Values on which to apply equation
-   * @param[in] y exp(IN_i)/exp(sum(IN))
+   * @param[out] y exp(IN_i - max(IN)) / sum(exp(IN - max(IN)))
    */
   void equation(Eigen::MatrixXf &y, const Eigen::MatrixXf &x);
 
   std::string _type = "Activation";
   std::string _name = "Softmax";
   Eigen::MatrixXf _forward_input_with_softmax_applied;
+  // per-row max / sum / dot product, reused across steps
+  Eigen::VectorXf _row_stat;
 };
 }; // namespace Activations
 }; // namespace DeepLearningFramework
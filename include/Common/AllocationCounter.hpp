@@ -0,0 +1,39 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Heap allocation counter
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace DeepLearningFramework {
+/**
+ * Number of heap allocations (malloc/calloc/realloc, which also back
+ * operator new and Eigen) made by this process so far. Used to check that
+ * steady-state training steps do not allocate.
+ *
+ * Only counts when built with -DCOUNT_ALLOCATIONS=ON (glibc), otherwise 0.
+ */
+size_t allocationCount();
+} // namespace DeepLearningFramework
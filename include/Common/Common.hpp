@@ -21,9 +21,14 @@
 ///////////////////////////////////////////////////////////////////////////
 #pragma once
 
+#include "Gemm.hpp"
 #include "GlobalState.hpp"
+#include "Module.hpp"
+#include "Parallel.hpp"
 #include "mpi/MpiController.hpp"
 #include <Eigen/Dense>
+#include <algorithm>
+#include <cstdlib>
 #include <functional>
 #include <iomanip>
 #include <iostream>
@@ -78,8 +83,8 @@ public:
       done_status = 1;
     }
 
-    global_controller.mpiAllreduce<int>(&done_status, &done_rank_num, 1,
-                                        MPI_SUM);
+    // once per step, so without MPI_Allreduce's scratch allocation
+    global_controller.mpiAllreduceSum<int>(&done_status, &done_rank_num, 1);
     globalDoneRankNum() = done_rank_num;
   }
 
@@ -172,6 +177,73 @@ inline void pushGradients(Eigen::MatrixXf &grad, const int &tag) {
   }
 }
 
+// pushGradients on count values in place, e.g. a copy handed to a
+// background task
+inline void pushGradientBuffer(float *grad, const int &count,
+                               const int &tag) {
+  MPIController &global_controller = globalController();
+  global_controller.mpiPush<float>(grad, grad, count, tag);
+  if (global_controller.mpiRank() == 0) {
+    const float scale = 1.f / global_controller.mpiSize();
+    for (int i = 0; i < count; i++) {
+      grad[i] *= scale;
+    }
+  }
+}
+
+// Sum the rows of a row-sparse gradient of all ranks into rank 0 and
+// average them. Only the rows present on each rank are sent, and rank 0
+// ends up with the union of the rows.
+inline void pushSparseGradient(Parameter &parameter) {
+  MPIController &global_controller = globalController();
+  SparseGradient &gradient = *parameter.sparse;
+  const Eigen::Index width = gradient.width;
+
+  std::vector<int64_t> all_rows;
+  std::vector<float> all_values;
+  std::vector<int> row_counts, value_counts;
+  global_controller.mpiGatherv(gradient.rows, all_rows, row_counts, 0);
+  global_controller.mpiGatherv(gradient.values, all_values, value_counts, 0);
+  if (global_controller.mpiRank() != 0) {
+    return;
+  }
+
+  // rows first seen on another rank start from zero
+  std::vector<int64_t> merged(all_rows);
+  std::sort(merged.begin(), merged.end());
+  merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+  gradient.rows.swap(merged);
+  gradient.values.assign(gradient.rows.size() * width, 0.f);
+
+  const float scale = 1.f / global_controller.mpiSize();
+  for (size_t k = 0; k < all_rows.size(); k++) {
+    Eigen::Map<Eigen::ArrayXf>(gradient.row(all_rows[k]), width) +=
+        scale * Eigen::Map<Eigen::ArrayXf>(&all_values[k * width], width);
+  }
+}
+
+// Sum the parameter gradients of all ranks into rank 0 and average them.
+inline void pushParameterGradients(std::vector<Parameter> &parameters) {
+  MPIController &global_controller = globalController();
+
+  for (int i = 0; i < parameters.size(); i++) {
+    if (parameters[i].exchanged) {
+      continue;
+    }
+    if (parameters[i].sparse != nullptr) {
+      pushSparseGradient(parameters[i]);
+      continue;
+    }
+    float *grad = parameters[i].grad;
+    int count = parameters[i].size;
+    global_controller.mpiPush<float>(grad, grad, count, i);
+
+    if (global_controller.mpiRank() == 0) {
+      Eigen::Map<Eigen::ArrayXf>(grad, count) /= global_controller.mpiSize();
+    }
+  }
+}
+
 inline void barrier() {
   globalController().mpiBarrier();
   return;
@@ -201,12 +273,23 @@ inline void PullParametersStep(int step) {
 static SyncStatusDecorator<Eigen::MatrixXf &, const int &>
     PushGradients(pushGradients);
 
+static SyncStatusDecorator<float *, const int &, const int &>
+    PushGradientBuffer(pushGradientBuffer);
+
+static SyncStatusDecorator<std::vector<Parameter> &>
+    PushParameterGradients(pushParameterGradients);
+
 inline void initialize(const std::vector<int> &layers_size) {
   MPIController &global_controller = globalController();
 
   GlobalState &global_state = globalState();
   global_state.setLayersSize(layers_size);
 
+  initIntraOpParallelism();
+  const char *gemm_cache = std::getenv("PICOPEBBLE_GEMM_CACHE");
+  initGemmBackends(gemm_cache != nullptr ? gemm_cache : ".gemm_backends",
+                   global_controller.mpiLocalRank() == 0);
+
   if (globalParallelismMode() == PIPELINE_MODEL_PARALLELISM &&
       global_state.getLayersNum() - 1 < global_controller.mpiSize()) {
     Log() << "The network’s parameters can be distributed to a maximum of "
@@ -215,13 +298,10 @@ inline void initialize(const std::vector<int> &layers_size) {
   }
   global_state.layersDistribution();
 
-  /* init global weight and bias */
+  /* init global weight and bias, identical on every rank without any
+   * communication since they come from the counter-based RNG */
   global_state.initGlobalWeights();
   global_state.initGlobalBias();
-
-  if (globalParallelismMode() == DATA_PARALLELISM) {
-    PullParameters(globalTrainStatus());
-  }
 }
 
 inline void finalize() {
@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Dense GEMM with per-shape backend dispatch
+ */
+
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <string>
+
+namespace DeepLearningFramework {
+
+enum GemmBackend { EIGEN_GEMM, BLAS_GEMM };
+
+/**
+ * c = op(a) * op(b), or c += op(a) * op(b) when accumulating, where op
+ * transposes its argument if the matching flag is set. c is resized when
+ * overwritten and must not alias a or b.
+ *
+ * Built with a system CBLAS (-DUSE_BLAS=ON, the default when one is found),
+ * every (m, n, k, transposes) shape is timed on Eigen and on BLAS the first
+ * time it is seen and then always runs on the faster one. Otherwise this is
+ * Eigen's GEMM.
+ *
+ * @param[in,out] c result
+ * @param[in] a left operand
+ * @param[in] transpose_a use a^T
+ * @param[in] b right operand
+ * @param[in] transpose_b use b^T
+ * @param[in] accumulate add to c instead of overwriting it
+ */
+void gemm(Eigen::MatrixXf &c, const Eigen::MatrixXf &a, bool transpose_a,
+          const Eigen::MatrixXf &b, bool transpose_b, bool accumulate = false);
+
+using RowMajorMatrixXi8 =
+    Eigen::Matrix<int8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+enum Int8Isa { INT8_EIGEN, INT8_AVX2, INT8_AVX_VNNI };
+
+/* Whether the CPU can run the gemmInt8 kernel for isa. */
+bool int8IsaSupported(Int8Isa isa);
+
+/**
+ * Kernel gemmInt8 runs, the fastest one the CPU supports unless set
+ * otherwise, e.g. by tests comparing the kernels. Must be set to a
+ * supported one.
+ */
+Int8Isa &int8Isa();
+
+/**
+ * c = a * b on int8 operands, accumulated exactly in int32. a is row-major
+ * and b column-major, so that both operands of each dot product are
+ * contiguous. Runs on AVX-VNNI or AVX2 when the CPU has them (checked at
+ * run time, see int8Isa), with 32 or 16 multiply-adds per instruction, else
+ * on Eigen's GEMM over operands widened to int32.
+ *
+ * @param[out] c [m, n] result, resized
+ * @param[in] a [m, k] left operand
+ * @param[in] b [k, n] right operand
+ */
+void gemmInt8(Eigen::MatrixXi &c, const RowMajorMatrixXi8 &a,
+              const Eigen::Matrix<int8_t, Eigen::Dynamic, Eigen::Dynamic> &b);
+
+using RowMajorMatrixXbf16 = Eigen::Matrix<Eigen::bfloat16, Eigen::Dynamic,
+                                          Eigen::Dynamic, Eigen::RowMajor>;
+
+/**
+ * c = a * b, or c += a * b when accumulating, on bf16 operands with fp32
+ * products and sums. a is row-major and b column-major, so that
+ * neighbouring values along k are contiguous in both; either may be a Map,
+ * e.g. of a column-major matrix as the row-major view of its transpose.
+ * Runs on AVX512-BF16 when the CPU has it (checked at run time), with a
+ * packed into panels of 16 rows and 32 multiply-adds per instruction, else
+ * on Eigen's GEMM over operands widened to fp32.
+ *
+ * @param[in,out] c [m, n] result, resized when overwritten
+ * @param[in] a [m, k] left operand
+ * @param[in] b [k, n] right operand
+ * @param[in] accumulate add to c instead of overwriting it
+ */
+void gemmBf16(
+    Eigen::MatrixXf &c, const Eigen::Ref<const RowMajorMatrixXbf16> &a,
+    const Eigen::Ref<const Eigen::Matrix<Eigen::bfloat16, Eigen::Dynamic,
+                                         Eigen::Dynamic>> &b,
+    bool accumulate = false);
+
+/**
+ * dst = src rounded to the nearest bf16 value, 16 values per instruction on
+ * AVX512-BF16 when the CPU has it, which also flushes denormals to zero,
+ * else Eigen's cast.
+ *
+ * @param[out] dst resized to the shape of src
+ * @param[in] src
+ */
+void castBf16(
+    Eigen::Matrix<Eigen::bfloat16, Eigen::Dynamic, Eigen::Dynamic> &dst,
+    const Eigen::MatrixXf &src);
+
+/**
+ * Backend used for a shape, running the benchmark if it is new. The
+ * benchmark runs without blocking the other threads, which take Eigen for
+ * that shape until it is done.
+ *
+ * @param[in] m rows of c
+ * @param[in] n columns of c
+ * @param[in] k inner dimension
+ * @param[in] transpose_a
+ * @param[in] transpose_b
+ */
+GemmBackend gemmBackend(Eigen::Index m, Eigen::Index n, Eigen::Index k,
+                        bool transpose_a, bool transpose_b);
+
+/**
+ * Load the backend choices that earlier runs on the same host, BLAS library
+ * and intra-op thread count cached in cache_path, and append the new ones
+ * there if write_cache. An empty path keeps them in memory only. Called by
+ * initialize(), which lets one rank per host write.
+ *
+ * @param[in] cache_path text file of "host blas threads m n k ta tb backend"
+ * lines
+ * @param[in] write_cache whether to append the new choices
+ */
+void initGemmBackends(const std::string &cache_path, bool write_cache);
+} // namespace DeepLearningFramework
@@ -22,18 +22,19 @@
 #pragma once
 
 #include "GlobalState.hpp"
+#include "Random.hpp"
 #include "mpi/MpiController.hpp"
 #include <Eigen/Dense>
 #include <Module.hpp>
 #include <iostream>
 #include <vector>
 
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
 #include <functional>
-#include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <type_traits>
 
@@ -47,75 +48,215 @@ enum ParallelismMode {
 
 enum TrainMode { SYNC, ASYNC };
 
-template <typename F, typename... Args> struct invoke_result {
-  using type = decltype(std::declval<F>()(std::declval<TrainStatus>(),
-                                          std::declval<Args>()...));
-};
-
-template <typename F, typename... Args>
-using invoke_result_t = typename invoke_result<F, Args...>::type;
-
+// FP32: fp32 everywhere.
+// MIXED_BF16: bf16 saved activations and GEMM operands, fp32 sums and
+// master weights.
+enum PrecisionMode { FP32, MIXED_BF16 };
+
+using MatrixXbf16 =
+    Eigen::Matrix<Eigen::bfloat16, Eigen::Dynamic, Eigen::Dynamic>;
+using MatrixXi8 = Eigen::Matrix<int8_t, Eigen::Dynamic, Eigen::Dynamic>;
+
+/**
+ * BackgroundThread class
+ *
+ * One worker thread running the tasks posted by any thread, in order. Tasks
+ * live in a fixed ring of pooled slots, a bounded multi-producer
+ * single-consumer queue: a producer claims a slot with one CAS and
+ * publishes it through the slot's sequence number, and the worker frees it
+ * by advancing that number a lap. The callable is stored inline in the slot,
+ * and post(f, tensor) copies the tensor into a buffer the slot keeps, so
+ * steady-state posts neither lock nor allocate. An idle worker spins for a
+ * while before parking on a condition variable, which producers only
+ * signal while it is parked.
+ */
 class BackgroundThread {
 public:
-  explicit BackgroundThread() : m_stop(false) {
-    worker = std::thread([this]() {
-      while (true) {
-        std::unique_lock<std::mutex> lock(this->m_mtx);
-
-        this->m_cv.wait(
-            lock, [this]() { return this->m_stop || !this->tasks.empty(); });
-
-        if (this->m_stop && this->tasks.empty())
-          return;
+  // slots in the ring, a power of two. Bounds how far producers run ahead
+  // of the worker, and each slot keeps the largest tensor it carried.
+  static constexpr size_t kTasks = 128;
+  // bytes of captures a task can store inline
+  static constexpr size_t kTaskBytes = 64;
+  // queue polls before the worker, or a waiting run(), parks
+  static constexpr int kSpins = 2000;
+
+  // spinning only helps when the other side runs on another core
+  BackgroundThread()
+      : _tasks(new Task[kTasks]),
+        _spins(std::thread::hardware_concurrency() > 1 ? kSpins : 0) {
+    for (size_t i = 0; i < kTasks; i++) {
+      _tasks[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _worker = std::thread([this]() { work(); });
+  }
 
-        std::function<void()> task = std::move(this->tasks.front());
-        this->tasks.pop();
+  BackgroundThread(const BackgroundThread &) = delete;
+  BackgroundThread &operator=(const BackgroundThread &) = delete;
+
+  /* Run f() on the background thread. */
+  template <typename F> void post(F &&f) {
+    using Callable = typename std::decay<F>::type;
+    size_t position;
+    Task &task = claim(position);
+    store<Callable>(task, std::forward<F>(f));
+    task.run = [](Task &task) {
+      Callable &callable = *reinterpret_cast<Callable *>(&task.storage);
+      callable();
+      callable.~Callable();
+    };
+    publish(task, position);
+  }
 
-        lock.unlock();
+  /**
+   * Run f(tensor) on the background thread, on a copy of tensor held by the
+   * task's slot. The caller may reuse tensor right away.
+   */
+  template <typename F> void post(F &&f, const Eigen::MatrixXf &tensor) {
+    using Callable = typename std::decay<F>::type;
+    size_t position;
+    Task &task = claim(position);
+    task.tensor.assign(tensor.data(), tensor.data() + tensor.size());
+    task.rows = tensor.rows();
+    task.cols = tensor.cols();
+    store<Callable>(task, std::forward<F>(f));
+    task.run = [](Task &task) {
+      Callable &callable = *reinterpret_cast<Callable *>(&task.storage);
+      Eigen::Map<Eigen::MatrixXf> tensor(task.tensor.data(), task.rows,
+                                         task.cols);
+      callable(tensor);
+      callable.~Callable();
+    };
+    publish(task, position);
+  }
 
-        task();
+  /* Run f() on the background thread and wait for it. */
+  template <typename F> void run(const F &f) {
+    std::atomic<bool> done(false);
+    post([this, &f, &done]() {
+      f();
+      done.store(true, std::memory_order_release);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (_waiters.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done_cv.notify_all();
       }
     });
+    for (int spin = 0; spin < _spins; spin++) {
+      if (done.load(std::memory_order_acquire)) {
+        return;
+      }
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    _waiters.fetch_add(1, std::memory_order_seq_cst);
+    _done_cv.wait(lock,
+                  [&done]() { return done.load(std::memory_order_acquire); });
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
   }
 
-  template <typename F, typename... Args>
-  auto enqueue(F &&f, TrainStatus train_status, Args &&...args)
-      -> std::future<invoke_result_t<F, Args...>> {
-    using return_type = invoke_result_t<F, Args...>;
-    auto task = std::make_shared<std::packaged_task<return_type()>>(std::bind(
-        std::forward<F>(f), train_status, std::forward<Args>(args)...));
-    std::future<return_type> res = task->get_future();
+  ~BackgroundThread() {
     {
-      std::unique_lock<std::mutex> lock(m_mtx);
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop.store(true);
+    }
+    _cv.notify_all();
 
-      if (m_stop) {
-        throw std::runtime_error("enqueue on stopped Thread pool");
-      }
+    _worker.join();
+  }
 
-      // add task
-      tasks.emplace([task = std::move(task),
-                     train_status = std::move(train_status)]() { (*task)(); });
+private:
+  struct Task {
+    // position + 1 once published, position + kTasks once run
+    std::atomic<size_t> sequence;
+    // runs the callable in storage and destroys it
+    void (*run)(Task &task);
+    typename std::aligned_storage<kTaskBytes, alignof(std::max_align_t)>::type
+        storage;
+    // tensor handed to the task, keeping its capacity between tasks
+    std::vector<float> tensor;
+    Eigen::Index rows;
+    Eigen::Index cols;
+  };
+
+  /* Claim the next free slot, waiting while the ring is full. */
+  Task &claim(size_t &position) {
+    if (_stop.load(std::memory_order_relaxed)) {
+      throw std::runtime_error("post on stopped BackgroundThread");
+    }
+    position = _tail.load(std::memory_order_relaxed);
+    while (true) {
+      Task &task = _tasks[position & (kTasks - 1)];
+      const std::ptrdiff_t lap = static_cast<std::ptrdiff_t>(
+          task.sequence.load(std::memory_order_acquire) - position);
+      if (lap == 0) {
+        if (_tail.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          return task;
+        }
+      } else {
+        if (lap < 0) {
+          std::this_thread::yield();
+        }
+        position = _tail.load(std::memory_order_relaxed);
+      }
     }
-    m_cv.notify_one();
-    return res;
   }
 
-  ~BackgroundThread() {
-    {
-      std::unique_lock<std::mutex> lock(m_mtx);
-      m_stop = true;
+  template <typename Callable, typename F> void store(Task &task, F &&f) {
+    static_assert(sizeof(Callable) <= kTaskBytes,
+                  "task captures exceed BackgroundThread::kTaskBytes");
+    new (&task.storage) Callable(std::forward<F>(f));
+  }
+
+  /* Hand a filled slot to the worker, waking it if it is parked. */
+  void publish(Task &task, size_t position) {
+    task.sequence.store(position + 1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_parked.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _cv.notify_one();
     }
-    m_cv.notify_all();
+  }
 
-    worker.join();
+  void work() {
+    size_t head = 0;
+    int spins = 0;
+    while (true) {
+      Task &task = _tasks[head & (kTasks - 1)];
+      auto published = [&task, head]() {
+        return task.sequence.load(std::memory_order_acquire) == head + 1;
+      };
+      if (published()) {
+        task.run(task);
+        task.sequence.store(head + kTasks, std::memory_order_release);
+        head++;
+        spins = 0;
+        continue;
+      }
+      if (_stop.load()) {
+        return;
+      }
+      if (++spins < _spins) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(_mutex);
+      _parked.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      _cv.wait(lock, [&]() { return published() || _stop.load(); });
+      _parked.store(false, std::memory_order_relaxed);
+      spins = 0;
+    }
   }
 
-private:
-  std::thread worker;
-  std::queue<std::function<void()>> tasks;
-  std::mutex m_mtx;
-  std::condition_variable m_cv;
-  bool m_stop;
+  std::unique_ptr<Task[]> _tasks;
+  const int _spins;
+  std::atomic<size_t> _tail{0};
+  std::atomic<bool> _stop{false};
+  std::atomic<bool> _parked{false};
+  std::atomic<int> _waiters{0};
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::condition_variable _done_cv;
+  std::thread _worker;
 };
 
 inline BackgroundThread &globalBackgroundThread() {
@@ -133,11 +274,28 @@ inline TrainMode &globalTrainMode() {
   return global_train_mode;
 }
 
+inline PrecisionMode &globalPrecisionMode() {
+  static PrecisionMode global_precision_mode = FP32;
+  return global_precision_mode;
+}
+
 inline ParallelismMode &globalParallelismMode() {
   static ParallelismMode global_parallelism_mode = TENSOR_MODEL_PARALLELISM;
   return global_parallelism_mode;
 }
 
+/**
+ * Run a collective f() in step with the other ranks: inline in SYNC mode,
+ * on the background thread, which owns all communication, in ASYNC mode.
+ */
+template <typename F> void runCollective(const F &f) {
+  if (globalTrainMode() == SYNC) {
+    f();
+    return;
+  }
+  globalBackgroundThread().run(f);
+}
+
 class GlobalState {
 public:
   GlobalState() { initParameterInterval(); }
@@ -215,19 +373,34 @@ public:
     }
   }
 
+  /* Global index of the n-th layer held by this rank. */
+  uint32_t globalLayerRank(int n) {
+    if (globalParallelismMode() == PIPELINE_MODEL_PARALLELISM) {
+      return _node_layers_rank[globalController().mpiRank()][n];
+    }
+    return n;
+  }
+
+  /* Weights are drawn from the counter-based RNG keyed by (seed, layer,
+   * element), so every rank generates the same values locally. */
   void initGlobalWeights() {
     const int mpi_rank = globalController().mpiRank();
     for (int i = 1; i < _node_layers_size[mpi_rank].size(); i = i + _interval) {
-      _global_weigths.emplace_back(Eigen::MatrixXf::Random(
-          _node_layers_size[mpi_rank][i - 1], _node_layers_size[mpi_rank][i]));
+      const RandomStream stream = {WEIGHTS_RANDOM,
+                                   globalLayerRank(_global_weigths.size()), 0};
+      _global_weigths.emplace_back(
+          randomMatrix(_node_layers_size[mpi_rank][i - 1],
+                       _node_layers_size[mpi_rank][i], stream));
     }
   }
 
   void initGlobalBias() {
     const int mpi_rank = globalController().mpiRank();
     for (int i = 1; i < _node_layers_size[mpi_rank].size(); i = i + _interval) {
+      const RandomStream stream = {BIAS_RANDOM,
+                                   globalLayerRank(_global_bias.size()), 0};
       _global_bias.emplace_back(
-          Eigen::MatrixXf::Random(1, _node_layers_size[mpi_rank][i]));
+          randomMatrix(1, _node_layers_size[mpi_rank][i], stream));
     }
   }
 
@@ -242,7 +415,9 @@ public:
   void setGlobalBias() {
     const int layers_num = _layers_size.size();
     for (int i = 1; i < layers_num; ++i) {
-      _global_bias.emplace_back(Eigen::MatrixXf::Random(1, _layers_size[i]));
+      const RandomStream stream = {BIAS_RANDOM, static_cast<uint32_t>(i - 1),
+                                   0};
+      _global_bias.emplace_back(randomMatrix(1, _layers_size[i], stream));
     }
   }
 
@@ -254,7 +429,34 @@ public:
     return _global_bias[layer_rank];
   }
 
+  /**
+   * Allocate this rank's shard of an embedding table. Row r of the table
+   * lives on rank r % shards, as column r / shards of a [dim, local rows]
+   * matrix, so each vector is contiguous.
+   *
+   * @return index of the table
+   */
+  int addEmbeddingTable(int64_t rows, int dim, int shards) {
+    const int rank = shards > 1 ? globalController().mpiRank() : 0;
+    const int64_t local_rows = rows > rank ? (rows - rank - 1) / shards + 1 : 0;
+    // vectors keyed by their global row, whatever the number of shards
+    const RandomStream stream = {
+        EMBEDDING_RANDOM, static_cast<uint32_t>(_embedding_shards.size()), 0};
+    Eigen::MatrixXf shard(dim, local_rows);
+    for (int64_t col = 0; col < local_rows; ++col) {
+      randomUniform(shard.col(col).data(), dim, (rank + col * shards) * dim,
+                    stream);
+    }
+    _embedding_shards.push_back(std::move(shard));
+    return _embedding_shards.size() - 1;
+  }
+
+  Eigen::MatrixXf &getEmbeddingShard(const int &table) {
+    return _embedding_shards[table];
+  }
+
 private:
+  std::vector<Eigen::MatrixXf> _embedding_shards;
   std::vector<Eigen::MatrixXf> _global_weigths;
   std::vector<Eigen::MatrixXf> _global_bias;
   std::vector<int> _layers_size;
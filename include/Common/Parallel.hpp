@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Intra-rank (intra-op) parallelism: thread budget and parallel loops
+ */
+
+#pragma once
+
+#include "GlobalState.hpp"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <thread>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace DeepLearningFramework {
+
+/* Minimum number of scalar operations worth splitting across threads. */
+constexpr Eigen::Index kMinParallelWork = 1 << 15;
+
+/* Number of intra-op threads per rank, 0 means derive it from the host. */
+inline int &globalIntraOpThreads() {
+  static int intra_op_threads = 0;
+  return intra_op_threads;
+}
+
+/**
+ * Split the cores of this host between the ranks running on it, so that
+ * `mpirun -np k` on one machine never oversubscribes, then hand the budget
+ * to Eigen's GEMM and to parallelFor.
+ */
+inline void initIntraOpParallelism() {
+  int &threads = globalIntraOpThreads();
+  if (threads <= 0) {
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    int local_size = globalController().mpiLocalSize();
+    threads = std::max(1, cores / std::max(1, local_size));
+  }
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+  Eigen::setNbThreads(threads);
+}
+
+/**
+ * Run f(begin, end) over [0, n) split into one contiguous chunk per thread.
+ *
+ * @param[in] n number of items
+ * @param[in] cost_per_item scalar operations per item, used to skip
+ * threading for small kernels
+ * @param[in] f callable taking (Eigen::Index begin, Eigen::Index end)
+ */
+template <typename F>
+inline void parallelFor(Eigen::Index n, Eigen::Index cost_per_item,
+                        const F &f) {
+#ifdef _OPENMP
+  const int threads = globalIntraOpThreads();
+  if (threads > 1 && n > 1 && n * cost_per_item >= kMinParallelWork) {
+#pragma omp parallel num_threads(threads)
+    {
+      const Eigen::Index nt = omp_get_num_threads();
+      const Eigen::Index chunk = (n + nt - 1) / nt;
+      const Eigen::Index begin = omp_get_thread_num() * chunk;
+      const Eigen::Index end = std::min(n, begin + chunk);
+      if (begin < end) {
+        f(begin, end);
+      }
+    }
+    return;
+  }
+#endif
+  if (n > 0) {
+    f(0, n);
+  }
+}
+
+/**
+ * Sum f(begin, end) over [0, n) split into one chunk per thread.
+ *
+ * @param[in] n number of items
+ * @param[in] cost_per_item scalar operations per item
+ * @param[in] f callable returning the partial sum of [begin, end)
+ */
+template <typename F>
+inline double parallelSum(Eigen::Index n, Eigen::Index cost_per_item,
+                          const F &f) {
+  double sum = 0.0;
+#ifdef _OPENMP
+  const int threads = globalIntraOpThreads();
+  if (threads > 1 && n > 1 && n * cost_per_item >= kMinParallelWork) {
+#pragma omp parallel num_threads(threads) reduction(+ : sum)
+    {
+      const Eigen::Index nt = omp_get_num_threads();
+      const Eigen::Index chunk = (n + nt - 1) / nt;
+      const Eigen::Index begin = omp_get_thread_num() * chunk;
+      const Eigen::Index end = std::min(n, begin + chunk);
+      if (begin < end) {
+        sum += f(begin, end);
+      }
+    }
+    return sum;
+  }
+#endif
+  if (n > 0) {
+    sum = f(0, n);
+  }
+  return sum;
+}
+
+} // namespace DeepLearningFramework
@@ -0,0 +1,133 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Counter-based random numbers (Philox4x32-10)
+ */
+
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <vector>
+
+namespace DeepLearningFramework {
+
+/* What a random sequence is used for, part of its counter. */
+enum RandomKind : uint32_t {
+  WEIGHTS_RANDOM,
+  BIAS_RANDOM,
+  EMBEDDING_RANDOM,
+  DROPOUT_RANDOM,
+  SHUFFLE_RANDOM,
+  EVAL_RANDOM
+};
+
+/**
+ * One random sequence: element e of the sequence is a pure function of
+ * (seed, kind, index, step, e), so any rank or thread can generate any part
+ * of it without state or communication.
+ */
+struct RandomStream {
+  RandomKind kind;
+  // instance, e.g. the global layer index
+  uint32_t index;
+  // e.g. the training step or the epoch
+  uint32_t step;
+};
+
+/* Seed of every random sequence, set before initialize(). */
+inline uint64_t &globalSeed() {
+  static uint64_t seed = 0x5eedULL;
+  return seed;
+}
+
+/**
+ * Philox4x32-10 block: four random words for a 128-bit counter and a 64-bit
+ * key (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+ */
+inline void philox4x32(const uint32_t counter[4], const uint32_t key[2],
+                       uint32_t out[4]) {
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2],
+           c3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; ++round) {
+    const uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+    const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+    const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+    const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+    c1 = static_cast<uint32_t>(p1);
+    c3 = static_cast<uint32_t>(p0);
+    c0 = n0;
+    c2 = n2;
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/**
+ * Random words block, block + 1, ... of a stream: block b holds elements
+ * [4b, 4b + 4).
+ *
+ * @param[in] stream sequence to draw from
+ * @param[in] block first block
+ * @param[in] blocks number of blocks
+ * @param[out] out 4 * blocks words
+ */
+void randomBits(const RandomStream &stream, uint64_t block, uint64_t blocks,
+                uint32_t *out);
+
+/**
+ * Fill values with elements [offset, offset + count) of a stream, mapped to
+ * uniform floats in [low, high). Runs on the intra-op threads.
+ *
+ * @param[out] values count floats
+ * @param[in] count number of elements
+ * @param[in] offset index of the first element in the stream
+ * @param[in] stream sequence to draw from
+ * @param[in] low lower bound
+ * @param[in] high upper bound
+ */
+void randomUniform(float *values, Eigen::Index count, uint64_t offset,
+                   const RandomStream &stream, float low = -1.f,
+                   float high = 1.f);
+
+/* rows x cols matrix of uniform floats in [low, high), in column-major
+ * element order, e.g. the initial weights of a layer. */
+Eigen::MatrixXf randomMatrix(Eigen::Index rows, Eigen::Index cols,
+                             const RandomStream &stream, float low = -1.f,
+                             float high = 1.f);
+
+/**
+ * Random permutation of [0, n) (Fisher-Yates), identical on every rank
+ * drawing from the same stream.
+ *
+ * @param[out] permutation n indices
+ * @param[in] n number of indices
+ * @param[in] stream sequence to draw from, e.g. one step per epoch
+ */
+void randomPermutation(std::vector<int64_t> &permutation, int64_t n,
+                       const RandomStream &stream);
+} // namespace DeepLearningFramework
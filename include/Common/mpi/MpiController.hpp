@@ -22,6 +22,7 @@
 #pragma once
 
 #include "mpi/TypeTraits.hpp"
+#include <algorithm>
 #include <iostream>
 #include <mpi.h>
 #include <string>
@@ -35,7 +36,10 @@ enum TAG {
   FORWARD_PARAMETERS,
   BACKWARD_FLAG,
   BACKWARD_SHAPE,
-  BACKWARD_PARAMETERS
+  BACKWARD_PARAMETERS,
+  RESULT_SHAPE,
+  RESULT_PARAMETERS,
+  ALLREDUCE_SUM
 };
 
 inline bool &isSyncStopped() {
@@ -79,7 +83,9 @@ inline TrainStatus &trainFinishFlag() {
 
 class MPIController {
 public:
-  MPIController() : mpi_rank(-1), mpi_size(-1), mpi_comm(MPI_COMM_WORLD) {
+  MPIController()
+      : mpi_rank(-1), mpi_size(-1), mpi_local_rank(-1), mpi_local_size(-1),
+        mpi_comm(MPI_COMM_WORLD) {
     mpiInit();
   };
 
@@ -89,12 +95,22 @@ public:
 
   int &mpiSize() { return mpi_size; };
 
+  /* rank among the ranks sharing this host */
+  int &mpiLocalRank() { return mpi_local_rank; };
+
+  /* number of ranks sharing this host */
+  int &mpiLocalSize() { return mpi_local_size; };
+
   void mpiInit() {
     MPI_Init(nullptr, nullptr);
     MPI_Comm_size(mpi_comm, &mpi_size);
     MPI_Comm_rank(mpi_comm, &mpi_rank);
     MPI_Comm_dup(mpi_comm, &mpi_comm_pull);
     MPI_Comm_dup(mpi_comm, &mpi_comm_push);
+    MPI_Comm_split_type(mpi_comm, MPI_COMM_TYPE_SHARED, mpi_rank,
+                        MPI_INFO_NULL, &mpi_comm_local);
+    MPI_Comm_rank(mpi_comm_local, &mpi_local_rank);
+    MPI_Comm_size(mpi_comm_local, &mpi_local_size);
   };
 
   void setGlobalDoneRankNum(const int &num) { _global_done_rank_num = num; }
@@ -118,6 +134,55 @@ public:
                         getMPIDataType<T>(), root, mpi_comm);
   }
 
+  // Concatenate variable-length buffers of all ranks on root, in rank order;
+  // counts receives the length contributed by each rank.
+  template <typename T>
+  void mpiGatherv(const std::vector<T> &sendbuf, std::vector<T> &recvbuf,
+                  std::vector<int> &counts, int root) {
+    int count = sendbuf.size();
+    counts.resize(mpi_size);
+    MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, root, mpi_comm);
+
+    std::vector<int> displs(mpi_size, 0);
+    if (mpi_rank == root) {
+      for (int i = 1; i < mpi_size; ++i) {
+        displs[i] = displs[i - 1] + counts[i - 1];
+      }
+      recvbuf.resize(displs[mpi_size - 1] + counts[mpi_size - 1]);
+    }
+
+    MPI_Gatherv(sendbuf.data(), count, getMPIDataType<T>(), recvbuf.data(),
+                counts.data(), displs.data(), getMPIDataType<T>(), root,
+                mpi_comm);
+  }
+
+  // Exchange one value with every rank: recvbuf[i] is sendbuf[mpi_rank] of
+  // rank i.
+  template <typename T>
+  void mpiAlltoall(const std::vector<T> &sendbuf, std::vector<T> &recvbuf) {
+    recvbuf.resize(mpi_size);
+    MPI_Alltoall(sendbuf.data(), 1, getMPIDataType<T>(), recvbuf.data(), 1,
+                 getMPIDataType<T>(), mpi_comm);
+  }
+
+  // Send sendcounts[i] consecutive values to rank i and receive
+  // recvcounts[i] values from rank i, both in rank order.
+  template <typename T>
+  void mpiAlltoallv(const std::vector<T> &sendbuf,
+                    const std::vector<int> &sendcounts, std::vector<T> &recvbuf,
+                    const std::vector<int> &recvcounts) {
+    std::vector<int> sdispls(mpi_size, 0), rdispls(mpi_size, 0);
+    for (int i = 1; i < mpi_size; ++i) {
+      sdispls[i] = sdispls[i - 1] + sendcounts[i - 1];
+      rdispls[i] = rdispls[i - 1] + recvcounts[i - 1];
+    }
+    recvbuf.resize(rdispls[mpi_size - 1] + recvcounts[mpi_size - 1]);
+
+    MPI_Alltoallv(sendbuf.data(), sendcounts.data(), sdispls.data(),
+                  getMPIDataType<T>(), recvbuf.data(), recvcounts.data(),
+                  rdispls.data(), getMPIDataType<T>(), mpi_comm);
+  }
+
   template <typename T>
   void mpiScatter(const T send_data[], int send_count, T &recv_data,
                   int recv_count, int root) {
@@ -295,23 +360,81 @@ public:
     }
   }
 
+  // Output of the last pipeline stage, returned to rank 0.
+  void mpiResultSend(std::vector<int> &shape) {
+    MPI_Send(shape.data(), 2, MPI_INT, 0, RESULT_SHAPE, mpi_comm);
+  }
+
+  void mpiResultRecv(std::vector<int> &shape) {
+    MPI_Recv(shape.data(), 2, MPI_INT, mpi_size - 1, RESULT_SHAPE, mpi_comm,
+             MPI_STATUS_IGNORE);
+  }
+
+  template <typename T> void mpiResultSend(T *array, int count) {
+    MPI_Send(array, count, getMPIDataType<T>(), 0, RESULT_PARAMETERS,
+             mpi_comm);
+  }
+
+  template <typename T> void mpiResultRecv(T *array, int count) {
+    MPI_Recv(array, count, getMPIDataType<T>(), mpi_size - 1,
+             RESULT_PARAMETERS, mpi_comm, MPI_STATUS_IGNORE);
+  }
+
+  // whether a result from the last stage can be received without blocking
+  bool mpiResultReady() {
+    int ready = 0;
+    MPI_Iprobe(mpi_size - 1, RESULT_SHAPE, mpi_comm, &ready,
+               MPI_STATUS_IGNORE);
+    return ready;
+  }
+
   template <typename T>
   void mpiAllreduce(T *sendbuf, T *recvbuf, int count, const MPI_Op &op) {
     MPI_Allreduce(sendbuf, recvbuf, count, getMPIDataType<T>(), op, mpi_comm);
   }
 
+  /* Sum of count values over the ranks, in recvbuf on every rank, which may
+   * be sendbuf. Sent to rank 0, summed in rank order and broadcast back:
+   * Open MPI's MPI_Allreduce mallocs a scratch buffer on every call, its
+   * point-to-point messages and MPI_Bcast reuse preallocated fragments. */
+  template <typename T>
+  void mpiAllreduceSum(const T *sendbuf, T *recvbuf, int count) {
+    if (mpi_rank == 0) {
+      sum_scratch.resize(count * sizeof(T));
+      T *tmp_recvbuf = reinterpret_cast<T *>(sum_scratch.data());
+      std::copy(sendbuf, sendbuf + count, recvbuf);
+      for (int i = 1; i < mpi_size; i++) {
+        MPI_Recv(tmp_recvbuf, count, getMPIDataType<T>(), i, ALLREDUCE_SUM,
+                 mpi_comm, MPI_STATUS_IGNORE);
+        for (int j = 0; j < count; j++) {
+          recvbuf[j] += tmp_recvbuf[j];
+        }
+      }
+    } else {
+      MPI_Send(sendbuf, count, getMPIDataType<T>(), 0, ALLREDUCE_SUM,
+               mpi_comm);
+    }
+    MPI_Bcast(recvbuf, count, getMPIDataType<T>(), 0, mpi_comm);
+  }
+
   void mpiFinalize() {
     MPI_Comm_free(&mpi_comm_pull);
     MPI_Comm_free(&mpi_comm_push);
+    MPI_Comm_free(&mpi_comm_local);
     MPI_Finalize();
   };
 
 private:
   int mpi_rank;
   int mpi_size;
+  int mpi_local_rank;
+  int mpi_local_size;
   MPI_Comm mpi_comm;
   MPI_Comm mpi_comm_pull;
   MPI_Comm mpi_comm_push;
+  MPI_Comm mpi_comm_local;
+  // rank 0's receive buffer in mpiAllreduceSum, kept to not allocate
+  std::vector<char> sum_scratch;
   int _global_done_rank_num;
 };
 
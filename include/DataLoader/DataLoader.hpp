@@ -24,15 +24,52 @@
  */
 
 #pragma once
+#include "Module.hpp"
 #include <Eigen/Dense>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace DeepLearningFramework {
+/**
+ * Binary part file written by DataLoader::convert, a drop-in replacement for
+ * the CSV part file of the same name:
+ *
+ *   DatasetPartHeader
+ *   rows x cols values of type dtype, column-major, at offset
+ *   kDatasetPartAlignment
+ *
+ * Values are in host byte order.
+ */
+struct DatasetPartHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t dtype;
+  uint64_t rows;
+  uint64_t cols;
+};
+
+enum DatasetDtype : uint32_t { DATASET_FLOAT32 };
+
+constexpr char kDatasetPartMagic[8] = {'P', 'P', 'B', 'L', 'D', 'A', 'T', 'A'};
+constexpr uint32_t kDatasetPartVersion = 1;
+constexpr size_t kDatasetPartAlignment = 64;
+
 /**
  * DataLoader class
  *
- * load: load dataset
+ * load: load dataset, CSV or binary part files, in pipeline parallelism
+ * features on the first stage and labels on the last one only
+ * loadSparse: load dataset with sparse features
+ * convert: write the binary part files of a CSV dataset
+ *
+ * A part that cannot be read, or is not a valid part, fails the load of its
+ * whole matrix, which is left empty with an error on stderr: skipping it
+ * would silently train on part of the data.
  */
 class DataLoader {
 public:
@@ -43,10 +80,192 @@ public:
                    Eigen::MatrixXf &y_train, Eigen::MatrixXf &X_test,
                    Eigen::MatrixXf &y_test);
 
+  /**
+   * Load a dataset whose features are sparse. Each line of a feature part
+   * file holds the non-zeros of one sample as "column:value" pairs separated
+   * by spaces or commas; labels are read as in load.
+   *
+   * @param[in] path dataset directory
+   * @param[in] feature_dim number of feature columns
+   */
+  static void loadSparse(const std::string &path, Eigen::Index feature_dim,
+                         SparseBatch &X_train, Eigen::MatrixXf &y_train,
+                         SparseBatch &X_test, Eigen::MatrixXf &y_test);
+
+  /**
+   * Convert the CSV part files of a dataset (train/test features/labels) to
+   * binary part files with the same names under output_path, which load()
+   * then maps without parsing. The parts are spread over the ranks, and all
+   * of them are written when any rank returns.
+   *
+   * @param[in] path CSV dataset directory
+   * @param[in] output_path binary dataset directory, created if needed
+   * @return whether every part was converted
+   */
+  static bool convert(const std::string &path, const std::string &output_path);
+
 private:
-  static Eigen::MatrixXf readMatrixFromFile(const std::string &filename);
+  /* Parse one CSV part, false if it cannot be read. */
+  static bool readMatrixFromFile(const std::string &filename,
+                                 Eigen::MatrixXf &matrix);
+  static bool writeBinaryPart(const std::string &filename,
+                              const Eigen::MatrixXf &matrix);
+  /**
+   * Map and concatenate binary parts, false if the first is not binary.
+   * Once the first is, any invalid part leaves concat_matrix empty.
+   * With shard, only the rows of this rank's share (see BatchStream).
+   */
+  static bool loadBinaryMatrix(const std::vector<std::string> &part_files,
+                               Eigen::MatrixXf &concat_matrix,
+                               bool shard = false);
   static std::vector<std::string> listFiles(const std::string &path);
-  static void loadMatrix(const std::string &path,
-                         Eigen::MatrixXf &concat_matrix);
+  /**
+   * Load this rank's share of the samples in the parts of a directory,
+   * returns the bytes of CSV parsed. Without load, a pipeline stage only
+   * learns the number of rows (the matrix has no column). Collective: a
+   * part that fails the load on one rank leaves the matrix empty on all.
+   */
+  static size_t loadMatrix(const std::string &path,
+                           Eigen::MatrixXf &concat_matrix, bool load = true);
+  /**
+   * Parse CSV parts, several at once on the intra-op threads. Each part is
+   * mmap-ed, its rows counted, and then parsed with an allocation-free
+   * float parser straight into its block of concat_matrix.
+   * With shard, only the rows of this rank's share are parsed. A part that
+   * cannot be read, or a token parsed that is not a number, leaves
+   * concat_matrix empty.
+   *
+   * @return bytes parsed
+   */
+  static size_t loadCsvMatrix(const std::vector<std::string> &part_files,
+                              Eigen::MatrixXf &concat_matrix,
+                              bool shard = false);
+  static void loadSparseMatrix(const std::string &path, Eigen::Index cols,
+                               SparseBatch &concat_matrix);
+
+  friend class BatchStream;
+};
+
+/**
+ * BatchStream class
+ *
+ * Batches of one split of a dataset (the same directory layout as
+ * DataLoader::load) read from its part files while they are consumed, so
+ * the split is never held in memory. A prefetch thread decodes the next
+ * batches into a ring of reusable buffers, overlapping I/O with compute:
+ *
+ *   BatchStream train(path, "train", batch_size);
+ *   for (const BatchStream::Batch &batch : train) { ... }
+ *
+ * Every begin() starts a new pass over the parts. Batches span part
+ * boundaries; the rows left over at the end fill a last, smaller batch
+ * unless drop_last is set. As with DataLoader::load, a part that cannot be
+ * read or does not match the others leaves the split empty.
+ *
+ * In data parallelism each rank streams an equal share of the samples; in
+ * pipeline parallelism, only the first stage reads features and only the
+ * last one labels, as with DataLoader::load. With
+ * shuffle, every pass draws a new permutation of all samples, the same on
+ * every rank (seeded by globalSeed() and the pass), and each rank reads its
+ * share of it from the parts directly: no sample moves between ranks.
+ */
+class BatchStream {
+public:
+  struct Batch {
+    Eigen::MatrixXf features;
+    Eigen::MatrixXf labels;
+    // labels one-hot over classes() columns, with encodeLabels(true)
+    Eigen::MatrixXf one_hot_labels;
+  };
+
+  class Iterator {
+  public:
+    const Batch &operator*() const;
+    const Batch *operator->() const { return &**this; }
+    /* Hand the batch back to the prefetch thread and wait for the next. */
+    Iterator &operator++();
+    bool operator!=(const Iterator &other) const {
+      return _index != other._index;
+    }
+
+  private:
+    friend class BatchStream;
+    Iterator(BatchStream *stream, Eigen::Index index)
+        : _stream(stream), _index(index) {}
+
+    BatchStream *_stream;
+    Eigen::Index _index;
+  };
+
+  /**
+   * Collective like DataLoader::load: lists the part files of the split and
+   * counts their rows, without keeping any of them.
+   *
+   * @param[in] path dataset directory
+   * @param[in] split "train" or "test"
+   * @param[in] batch_size rows per batch
+   * @param[in] drop_last skip the last batch if it is smaller
+   * @param[in] shuffle visit the samples in a new order every pass
+   * @param[in] prefetch number of batches decoded ahead
+   */
+  BatchStream(const std::string &path, const std::string &split,
+              Eigen::Index batch_size, bool drop_last = true,
+              bool shuffle = true, int prefetch = 2);
+  ~BatchStream();
+
+  BatchStream(const BatchStream &) = delete;
+  BatchStream &operator=(const BatchStream &) = delete;
+
+  /* Start a pass, stopping the previous one if it did not reach the end. */
+  Iterator begin();
+  Iterator end() { return Iterator(this, _batch_count); }
+
+  Eigen::Index batchCount() const { return _batch_count; }
+  /* Rows this rank streams per pass */
+  Eigen::Index rows() const { return _rows; }
+  /* Largest class label of the split + 1, 0 unless labels are one column */
+  Eigen::Index classes() const { return _classes; }
+
+  /**
+   * One-hot encode the labels of the next passes on the prefetch thread,
+   * into Batch::one_hot_labels, so consumers never encode them.
+   */
+  void encodeLabels(bool one_hot) { _one_hot = one_hot; }
+
+private:
+  /* Prefetch thread body, fills the ring for one pass. */
+  void produce();
+  void stop();
+  /* Wait until batch index is decoded, false if the pass ended before. */
+  bool acquire(Eigen::Index index);
+  void release();
+
+  std::vector<std::string> _feature_files;
+  std::vector<std::string> _label_files;
+  // first row of every part in the split, and the split size last
+  std::vector<Eigen::Index> _part_begin;
+  Eigen::Index _batch_size;
+  // rows [_shard_begin, _shard_begin + _rows) of the pass order are ours
+  Eigen::Index _shard_begin;
+  Eigen::Index _rows;
+  Eigen::Index _batch_count;
+  Eigen::Index _classes;
+  bool _one_hot;
+  // whether this pipeline stage reads the features and the labels
+  bool _read_features;
+  bool _read_labels;
+  bool _shuffle;
+  uint32_t _pass;
+  std::vector<int64_t> _order;
+  std::vector<Batch> _ring;
+
+  std::thread _producer;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  // batches decoded and handed back in the current pass
+  Eigen::Index _produced;
+  Eigen::Index _consumed;
+  bool _done;
+  bool _stop;
 };
 }; // namespace DeepLearningFramework
@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * BatchNorm1d and SyncBatchNorm layer class definitions
+ */
+
+#pragma once
+
+#include "GlobalState.hpp"
+#include "Module.hpp"
+
+#include <vector>
+
+namespace DeepLearningFramework {
+namespace Layers {
+/**
+ * Layer class: BatchNorm1d.
+ *
+ * forward: output = (input - mean) / sqrt(var + eps) * gamma + beta, with the
+ * mean and variance of each feature over the batch, taken in one pass that
+ * also updates the running statistics used by predict
+ * backward: gradients of gamma and beta, applied later by the optimizer, and
+ * the input gradient from the same two per-feature sums
+ *
+ * In data parallelism the statistics are those of the local batch and the
+ * gradients of gamma and beta are averaged over the ranks with one
+ * MPI_Allreduce per step, so every rank applies the same update. Pipeline
+ * parallelism splits models into [Linear, activation] pairs and does not
+ * support normalization layers.
+ */
+class BatchNorm1d : public Module {
+public:
+  BatchNorm1d(int features, float eps = 1e-5f, float momentum = 0.1f);
+  ~BatchNorm1d() = default;
+
+  /**
+   * Forward pass of the BatchNorm1d layer, with batch statistics.
+   *
+   * @param[out] out normalized, scaled and shifted input
+   * @param[in] x [batch, features] values to normalize
+   */
+  void forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  /**
+   * Backward pass of the BatchNorm1d layer.
+   *
+   * @param[out] din gradient w.r.t. the input
+   * @param[in] dout gradient w.r.t. the output
+   */
+  void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override;
+
+  /* Inference pass with the running statistics, input is not saved. */
+  void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  void printDescription() override;
+
+  /* Register gamma and beta, without weight decay. */
+  void collectParameters(std::vector<Parameter> &parameters) override;
+
+  void accumulateGradients(bool accumulate) override {
+    _accumulate = accumulate;
+  }
+
+  bool exchangesGradients() override;
+
+  int64_t getParametersCount() override { return 2 * _features; }
+
+  std::string getName() override { return _name; }
+
+  size_t getSavedActivationBytes() override;
+
+protected:
+  /* Whether batch statistics are taken over the batches of all ranks. */
+  virtual bool syncsStatistics() { return false; }
+
+  std::string _type = "Layer";
+  std::string _name = "BatchNorm1d";
+
+private:
+  /* Sum _stats over the ranks in place. */
+  void allreduceStatistics();
+
+  int _features;
+  float _eps;
+  float _momentum;
+  bool _accumulate = false;
+  // [1, features] scale and shift with their gradients
+  Eigen::MatrixXf _gamma;
+  Eigen::MatrixXf _beta;
+  Eigen::MatrixXf _gamma_grad;
+  Eigen::MatrixXf _beta_grad;
+  Eigen::ArrayXf _running_mean;
+  Eigen::ArrayXf _running_var;
+  // saved by forward: normalized input and 1 / std of each feature
+  Eigen::MatrixXf _xhat;
+  Eigen::ArrayXf _inv_std;
+  // per-feature sums followed by the sample count: [sum, sum of squares, n]
+  // in forward, [sum of dout * xhat, sum of dout, n] in backward
+  std::vector<float> _stats;
+  std::vector<float> _reduced;
+};
+
+/**
+ * Layer class: SyncBatchNorm.
+ *
+ * BatchNorm1d whose statistics are taken over the global batch in data
+ * parallelism: forward allreduces the per-feature sums and sums of squares
+ * together with the sample counts in a single message, and backward does the
+ * same with the two sums it needs, which are also the gradients of gamma and
+ * beta. Small per-rank batches therefore normalize with the statistics of
+ * the whole batch at one MPI_Allreduce per pass. Every rank must call
+ * forward and backward in step. Same as BatchNorm1d otherwise.
+ */
+class SyncBatchNorm : public BatchNorm1d {
+public:
+  SyncBatchNorm(int features, float eps = 1e-5f, float momentum = 0.1f)
+      : BatchNorm1d(features, eps, momentum) {
+    _name = "SyncBatchNorm";
+  }
+
+protected:
+  bool syncsStatistics() override { return true; }
+};
+}; // namespace Layers
+}; // namespace DeepLearningFramework
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Dropout layer class definition
+ */
+
+#pragma once
+
+#include "Module.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace DeepLearningFramework {
+namespace Layers {
+/**
+ * Layer class: Dropout.
+ *
+ * forward: output = input / (1 - p) with probability 1 - p, else 0, the kept
+ * elements saved as a packed bitmask (1 bit per element) for backward pass
+ * backward: output = input / (1 - p) where the element was kept, else 0
+ * predict: output = input
+ *
+ * Masks come from the counter-based RNG keyed by (seed, layer and rank,
+ * step, element), so a run is reproducible for a given seed and number of
+ * ranks, and each rank draws its own masks. Pipeline parallelism splits
+ * models into [Linear, activation] pairs and does not support it.
+ */
+class Dropout : public Module {
+public:
+  explicit Dropout(float p);
+  ~Dropout() = default;
+
+  /**
+   * Forward pass of the Dropout layer, draws a new mask.
+   *
+   * @param[out] out input with dropped elements zeroed, the rest rescaled
+   * @param[in] x Values on which to apply Dropout
+   */
+  void forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  /**
+   * Backward pass of the Dropout layer, with the mask of the last forward.
+   *
+   * @param[out] din dout through the mask of the last forward pass
+   * @param[in] dout Values on which to apply backpropagation
+   */
+  void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override;
+
+  /* Inference pass, the identity. */
+  void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  void printDescription() override;
+
+  int64_t getParametersCount() override { return 0; }
+
+  std::string getName() override { return _name; }
+
+  size_t getSavedActivationBytes() override {
+    return _mask.size() * sizeof(uint64_t);
+  }
+
+private:
+  std::string _type = "Layer";
+  std::string _name = "Dropout";
+  float _p;
+  // index of this layer among the Dropout layers, and forward passes so far
+  uint32_t _index;
+  uint32_t _step = 0;
+  // bit i of word i / 64 is set when element i was kept
+  std::vector<uint64_t> _mask;
+  static uint32_t _layer_count;
+};
+}; // namespace Layers
+}; // namespace DeepLearningFramework
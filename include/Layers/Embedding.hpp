@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Embedding layer class definition
+ */
+
+#pragma once
+
+#include "GlobalState.hpp"
+#include "Module.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace DeepLearningFramework {
+namespace Layers {
+/**
+ * Layer class: Embedding.
+ *
+ * forward: the input holds one categorical id per field, [batch, fields];
+ * the output concatenates the vectors of the fields, [batch, fields * dim].
+ * Ids stored as float are only exact below 2^24, larger ones are rejected:
+ * pass them as an IdBatch (forwardIds, or Sequential::forward on an IdBatch).
+ * backward: row gradients of the vectors used by the batch, applied later by
+ * the optimizer. The ids receive no gradient.
+ *
+ * In data parallelism the table is row-sharded across ranks in GlobalState
+ * (row r on rank r % size), so a table may exceed the memory of one node.
+ * The ids of a batch are deduplicated, routed to their owners with
+ * MPI_Alltoallv and the vectors are returned the same way; backward sends
+ * the summed row gradients back along the same route. Every rank must call
+ * forward/predict/backward in step. Otherwise the whole table is local.
+ */
+class Embedding : public Module {
+public:
+  Embedding(int64_t num_embeddings, int embedding_dim);
+  ~Embedding() = default;
+
+  /**
+   * Look up the vectors of a batch of ids.
+   *
+   * @param[out] out [batch, fields * dim] vectors
+   * @param[in] x [batch, fields] ids
+   */
+  void forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  /**
+   * Send the row gradients of the last forward pass to their owners.
+   *
+   * @param[out] din left empty, ids are not differentiable
+   * @param[in] dout gradient w.r.t. the output of the layer
+   */
+  void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override;
+
+  void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  /**
+   * Look up the vectors of a batch of integer ids.
+   *
+   * @param[out] out [batch, fields * dim] vectors
+   * @param[in] x [batch, fields] ids
+   */
+  void forwardIds(Eigen::MatrixXf &out, const IdBatch &x) override;
+
+  void predictIds(Eigen::MatrixXf &out, const IdBatch &x) override;
+
+  void printDescription() override;
+
+  /**
+   * Register the local shard as a row-sparse, sharded parameter.
+   *
+   * @param[out] parameters list to append to
+   */
+  void collectParameters(std::vector<Parameter> &parameters) override;
+
+  void accumulateGradients(bool accumulate) override {
+    _accumulate = accumulate;
+  }
+
+  bool exchangesGradients() override { return _shards > 1; }
+
+  int64_t getParametersCount() override;
+
+  std::string getName() override;
+
+  size_t getSavedActivationBytes() override;
+
+private:
+  /* Check that float ids are exact and convert them. */
+  const int64_t *toIds(const Eigen::MatrixXf &x);
+
+  /* Route [batch, fields] ids to their owners and gather their vectors. */
+  void lookup(Eigen::MatrixXf &out, const int64_t *ids, Eigen::Index batch,
+              Eigen::Index fields);
+
+  std::string _type = "Layer";
+  std::string _name = "Embedding";
+  int64_t _num_embeddings;
+  int _dim;
+  int _shards;
+  int _table;
+  bool _accumulate = false;
+  // gradient of the local rows written since the last update
+  SparseGradient _table_grad;
+
+  // ids of a float input
+  std::vector<int64_t> _input_ids;
+  // routing of the last lookup: distinct ids grouped by owner, the distinct
+  // id of each input element, and the ids other ranks asked this rank for
+  std::vector<int64_t> _ids;
+  std::vector<int> _positions;
+  std::vector<int> _send_counts;
+  std::vector<int> _recv_counts;
+  std::vector<int64_t> _recv_ids;
+  // [dim, distinct ids] vectors of the last lookup
+  std::vector<float> _vectors;
+};
+}; // namespace Layers
+}; // namespace DeepLearningFramework
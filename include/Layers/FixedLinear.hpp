@@ -0,0 +1,140 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * FixedLinear layer class definition
+ */
+
+#pragma once
+
+#include "GlobalState.hpp"
+#include "Linear.hpp"
+
+namespace DeepLearningFramework {
+namespace Layers {
+/**
+ * Layer class: FixedLinear.
+ *
+ * Linear layer specialized at compile time for batches of B rows, In inputs
+ * and Out outputs. Batches of that shape run on fixed-size Eigen matrices
+ * kept on the stack (or inside the layer), so the products are unrolled and
+ * nothing is allocated. Any other shape, pipeline parallelism and the mixed
+ * precision / int8 paths fall back to Linear.
+ *
+ * forward: output = input * weights + bias
+ * backward: compute gradients of Weights nd Bias; output = input * weights
+ */
+template <int B, int In, int Out> class FixedLinear : public Linear {
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  using InputMatrix = Eigen::Matrix<float, B, In>;
+  using OutputMatrix = Eigen::Matrix<float, B, Out>;
+  using WeightsMatrix = Eigen::Matrix<float, In, Out>;
+  using BiasVector = Eigen::Matrix<float, 1, Out>;
+
+  FixedLinear() : Linear(In, Out) {}
+  ~FixedLinear() = default;
+
+  void forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override {
+    if (!isFixedShape(x.rows())) {
+      Linear::forward(out, x);
+      return;
+    }
+    _fixed_input = Eigen::Map<const InputMatrix>(x.data());
+    Eigen::Map<const WeightsMatrix> weights(_weights->data());
+    Eigen::Map<const BiasVector> bias(_bias->data());
+
+    OutputMatrix result = _fixed_input.lazyProduct(weights);
+    result.rowwise() += bias;
+    out = result;
+  }
+
+  void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override {
+    if (!isFixedShape(dout.rows())) {
+      Linear::backward(din, dout);
+      return;
+    }
+    Eigen::Map<const OutputMatrix> grad(dout.data());
+    Eigen::Map<const WeightsMatrix> weights(_weights->data());
+    Eigen::Map<WeightsMatrix> weights_grad(_weights_grad.data());
+    Eigen::Map<BiasVector> bias_grad(_bias_grad.data());
+
+    // gradients of weights and bias, applied later by the optimizer
+    if (_accumulate) {
+      weights_grad.noalias() += _fixed_input.transpose().lazyProduct(grad);
+      bias_grad += grad.colwise().sum();
+    } else {
+      weights_grad.noalias() = _fixed_input.transpose().lazyProduct(grad);
+      bias_grad = grad.colwise().sum();
+    }
+
+    InputMatrix result = grad.lazyProduct(weights.transpose());
+    din = result;
+  }
+
+  size_t getSavedActivationBytes() override {
+    return Linear::getSavedActivationBytes() + sizeof(_fixed_input);
+  }
+
+private:
+  bool isFixedShape(Eigen::Index rows) {
+    return rows == B && globalParallelismMode() == DATA_PARALLELISM &&
+           globalPrecisionMode() == FP32;
+  }
+
+  InputMatrix _fixed_input;
+};
+
+template <int B, int In, int Out> Module *newFixedLinear() {
+  return new FixedLinear<B, In, Out>();
+}
+
+/**
+ * Create a Linear layer, specialized as FixedLinear<B, In, Out> when
+ * [input_size, output_size] is one of the compiled-in shapes.
+ *
+ * @param[in] input_size number of inputs
+ * @param[in] output_size number of outputs
+ */
+template <int B> Module *makeLinear(int input_size, int output_size) {
+  struct Entry {
+    int input_size;
+    int output_size;
+    Module *(*make)();
+  };
+  // iris {4, 10, 10, 3} and uniform_sample_size_per_part {2, 10, 10, 2}
+  static const Entry table[] = {
+      {4, 10, &newFixedLinear<B, 4, 10>},
+      {10, 10, &newFixedLinear<B, 10, 10>},
+      {10, 3, &newFixedLinear<B, 10, 3>},
+      {2, 10, &newFixedLinear<B, 2, 10>},
+      {10, 2, &newFixedLinear<B, 10, 2>},
+  };
+  for (const Entry &entry : table) {
+    if (entry.input_size == input_size && entry.output_size == output_size) {
+      return entry.make();
+    }
+  }
+  return new Linear(input_size, output_size);
+}
+}; // namespace Layers
+}; // namespace DeepLearningFramework
@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * LayerNorm layer class definition
+ */
+
+#pragma once
+
+#include "GlobalState.hpp"
+#include "Module.hpp"
+
+#include <vector>
+
+namespace DeepLearningFramework {
+namespace Layers {
+/**
+ * Layer class: LayerNorm.
+ *
+ * forward: output = (input - mean) / sqrt(var + eps) * gamma + beta, with the
+ * mean and variance of each sample over its features, taken in one pass
+ * backward: gradients of gamma and beta, applied later by the optimizer, and
+ * the input gradient from the two per-sample reductions of one pass
+ *
+ * In data parallelism the gradients of gamma and beta are averaged over the
+ * ranks with one MPI_Allreduce per step, so every rank applies the same
+ * update. Pipeline parallelism splits models into [Linear, activation] pairs
+ * and does not support normalization layers.
+ */
+class LayerNorm : public Module {
+public:
+  LayerNorm(int features, float eps = 1e-5f);
+  ~LayerNorm() = default;
+
+  /**
+   * Forward pass of the LayerNorm layer.
+   *
+   * @param[out] out normalized, scaled and shifted input
+   * @param[in] x [batch, features] values to normalize
+   */
+  void forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  /**
+   * Backward pass of the LayerNorm layer.
+   *
+   * @param[out] din gradient w.r.t. the input
+   * @param[in] dout gradient w.r.t. the output
+   */
+  void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override;
+
+  /* Inference pass, input is not saved. */
+  void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  void printDescription() override;
+
+  /* Register gamma and beta, without weight decay. */
+  void collectParameters(std::vector<Parameter> &parameters) override;
+
+  void accumulateGradients(bool accumulate) override {
+    _accumulate = accumulate;
+  }
+
+  bool exchangesGradients() override;
+
+  int64_t getParametersCount() override { return 2 * _features; }
+
+  std::string getName() override { return _name; }
+
+  size_t getSavedActivationBytes() override;
+
+private:
+  /* out = normalized x, also saved in xhat when set. */
+  void normalize(Eigen::MatrixXf &out, const Eigen::MatrixXf &x,
+                 Eigen::MatrixXf *xhat, Eigen::ArrayXf &inv_std);
+
+  std::string _type = "Layer";
+  std::string _name = "LayerNorm";
+  int _features;
+  float _eps;
+  bool _accumulate = false;
+  // [1, features] scale and shift with their gradients
+  Eigen::MatrixXf _gamma;
+  Eigen::MatrixXf _beta;
+  Eigen::MatrixXf _gamma_grad;
+  Eigen::MatrixXf _beta_grad;
+  // saved by forward: normalized input and 1 / std of each sample
+  Eigen::MatrixXf _xhat;
+  Eigen::ArrayXf _inv_std;
+  // per-sample reductions of forward and backward, _sum holds the mean in
+  // forward
+  Eigen::ArrayXf _sum;
+  Eigen::ArrayXf _sum_sq;
+  // [dgamma, dbeta] of one step, sent to the other ranks and received back
+  std::vector<float> _local_grads;
+  std::vector<float> _global_grads;
+};
+}; // namespace Layers
+}; // namespace DeepLearningFramework
@@ -25,16 +25,27 @@
 
 #pragma once
 
+#include "Gemm.hpp"
 #include "GlobalState.hpp"
 #include "Module.hpp"
 
+#include <atomic>
+
 namespace DeepLearningFramework {
 namespace Layers {
 /**
  * Layer class: Linear.
  *
  * forward: output = input * weights + bias
- * backward: update Weights nd Bias; output = input * weights
+ * backward: compute gradients of Weights nd Bias, applied later by the
+ * optimizer; output = input * weights
+ *
+ * In MIXED_BF16 precision mode and data parallelism the layer saves its
+ * input for backward as bf16, halving its activation memory, and runs its
+ * three GEMMs on bf16 operands with fp32 sums (see gemmBf16). The weights in
+ * GlobalState stay fp32, the master copy the optimizer updates; the layer
+ * keeps bf16 copies of them and their transpose, refreshed on the first
+ * forward after parametersChanged().
  */
 class Linear : public Module {
 public:
@@ -57,18 +68,52 @@ public:
    */
   void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override;
 
+  /**
+   * Inference pass of the Linear layer, input is not saved. Runs an int8
+   * GEMM with int32 accumulation once the layer has been quantized.
+   *
+   * @param[out] out input * weights + bias
+   * @param[in] x Values on which to apply weights and biases.
+   */
+  void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  /**
+   * Calibrate int8 inference: per-output-channel symmetric scales for the
+   * weights and a per-tensor scale for the input, taken from a sample batch.
+   * Must be called again after the weights are updated.
+   *
+   * @param[in] x sample of the inputs of this layer
+   */
+  void quantize(const Eigen::MatrixXf &x) override;
+
+  /* Return to fp32 inference */
+  void dequantize() override;
+
   /* Print description of Linear layer class */
   void printDescription() override;
 
   /**
-   * Set learning rate used to update weights and bias.
+   * Register weights and bias with their gradient buffers.
+   *
+   * @param[out] parameters list to append to
+   */
+  void collectParameters(std::vector<Parameter> &parameters) override;
+
+  /**
+   * Add the gradients of the following backward passes to the stored ones
+   * instead of overwriting them.
    *
-   * @param[in] lr learning rate to use.
+   * @param[in] accumulate whether to accumulate.
    */
-  void setLR(float lr);
+  void accumulateGradients(bool accumulate) override {
+    _accumulate = accumulate;
+  }
+
+  /* Mark the bf16 copies of the weights stale. */
+  void parametersChanged() override { _weights_bf16_stale = true; }
 
   /** Get the number of parameters of the Linear layer. */
-  uint32_t getParametersCount();
+  int64_t getParametersCount();
 
   /** get weights */
   Eigen::MatrixXf getWeights();
@@ -82,7 +127,13 @@ public:
 
   std::string getName();
 
-private:
+  /** Bytes held by the activations saved for the backward pass. */
+  size_t getSavedActivationBytes() override;
+
+protected:
+  /* Constructor for subclasses, which may keep their own weight gradient. */
+  Linear(int input_size, int output_size, bool dense_weights_grad);
+
   /**
    * Update weights and bias with given parameters.
    *
@@ -90,18 +141,44 @@ private:
    */
   void update();
 
+  /* out += bias, row by row */
+  void addBias(Eigen::MatrixXf &out);
+
+  /* Whether the GEMMs run on bf16 operands, see MIXED_BF16. */
+  bool bf16Gemms() const;
+
+  /* forward and backward on bf16 operands */
+  void forwardBf16(Eigen::MatrixXf &out, const Eigen::MatrixXf &x);
+  void backwardBf16(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout);
+
   std::string _type = "Layer";
   std::string _name = "Linear";
   Eigen::MatrixXf _forward_input;
+  MatrixXbf16 _forward_input_bf16;
+  // bf16 weights [input, output] and their transpose, and the bf16 copies of
+  // the other GEMM operands in the layout gemmBf16 reads
+  MatrixXbf16 _weights_bf16;
+  MatrixXbf16 _weights_transpose_bf16;
+  std::atomic<bool> _weights_bf16_stale{true};
+  RowMajorMatrixXbf16 _input_rows_bf16;
+  MatrixXbf16 _dout_bf16;
+  RowMajorMatrixXbf16 _dout_rows_bf16;
+  // int8 inference
+  bool _quantized = false;
+  float _input_scale = 1.f;
+  Eigen::RowVectorXf _weight_scales;
+  MatrixXi8 _weights_int8;
   int _input_size = -1;
   int _output_size = -1;
   // Eigen::MatrixXf _weights;
   // Eigen::MatrixXf _bias;
-  Eigen::MatrixXf *_weights;
-  Eigen::MatrixXf *_bias;
+  Eigen::MatrixXf *_weights = nullptr;
+  Eigen::MatrixXf *_bias = nullptr;
+  Eigen::MatrixXf _weights_grad;
+  Eigen::MatrixXf _bias_grad;
+  bool _accumulate = false;
   // Eigen::MatrixXf _weights = globalState().getWeights(_layer_rank);
   // Eigen::MatrixXf _bias = globalState().getBias(_layer_rank);
-  float _lr = 0.01f;
   int _layer_rank;
   static int _layer_count;
 };
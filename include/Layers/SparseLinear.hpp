@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * SparseLinear layer class definition
+ */
+
+#pragma once
+
+#include "Linear.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace DeepLearningFramework {
+namespace Layers {
+/**
+ * Layer class: SparseLinear.
+ *
+ * Linear layer for high-dimensional sparse inputs (bag-of-words, hashed
+ * one-hot features), meant as the first layer of the model.
+ *
+ * forward: output = input * weights + bias, a sparse * dense product over
+ * the non-zeros of the CSR batch
+ * backward: gradients of the weight rows of the input columns present in the
+ * batch, and of the bias. The gradient w.r.t. the input is not computed.
+ *
+ * The weights are stored in GlobalState as their column-major [output_size,
+ * input_size] transpose, so that the weights of each input feature are
+ * contiguous. The weight gradient is row-sparse (see SparseGradient): only
+ * the features present since the last update are stored, and the optimizer
+ * and the gradient exchange only visit those, so memory and compute scale
+ * with the number of non-zeros.
+ */
+class SparseLinear : public Linear {
+public:
+  SparseLinear(int input_size, int output_size);
+  ~SparseLinear() = default;
+
+  /**
+   * Forward pass on a dense batch, converted to CSR first.
+   *
+   * @param[out] out input * weights + bias
+   * @param[in] x Values on which to apply weights and biases.
+   */
+  void forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  /**
+   * Forward pass on a sparse batch, the batch is saved for backward.
+   *
+   * @param[out] out input * weights + bias
+   * @param[in] x CSR batch on which to apply weights and biases.
+   */
+  void forwardSparse(Eigen::MatrixXf &out, const SparseBatch &x) override;
+
+  /**
+   * Backward pass, fills the row-sparse weight gradient and the bias
+   * gradient.
+   *
+   * @param[out] din left empty, the input gradient is not computed
+   * @param[in] dout gradient w.r.t. the output of the layer
+   */
+  void backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) override;
+
+  void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) override;
+
+  void predictSparse(Eigen::MatrixXf &out, const SparseBatch &x) override;
+
+  /* int8 inference is not supported, the layer stays in fp32. */
+  void quantize(const Eigen::MatrixXf &x) override {}
+
+  void printDescription() override;
+
+  /**
+   * Register the row-sparse weights and the dense bias.
+   *
+   * @param[out] parameters list to append to
+   */
+  void collectParameters(std::vector<Parameter> &parameters) override;
+
+  size_t getSavedActivationBytes() override;
+
+private:
+  /* out = x * weights + bias */
+  void apply(Eigen::MatrixXf &out, const SparseBatch &x);
+
+  SparseBatch _sparse_input;
+  // gradient of the features present since the last update
+  SparseGradient _sparse_weights_grad;
+  // features present in the batch, and the offset of the gradient of each
+  // non-zero
+  std::vector<int64_t> _batch_rows;
+  std::vector<Eigen::Index> _grad_offsets;
+};
+}; // namespace Layers
+}; // namespace DeepLearningFramework
@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * CrossEntropy loss class definition
+ */
+
+#pragma once
+
+#include "Loss.hpp"
+
+#include <iostream>
+
+namespace DeepLearningFramework {
+namespace Losses {
+/**
+ * Loss class: CrossEntropy, fused with Softmax.
+ *
+ * Takes raw logits (no Softmax layer before it) and integer class labels.
+ *
+ * forward: output = 1/N * SUM(logsumexp(yPred_i) - yPred_i[y_i])
+ * backward: output = (Softmax(yPred) - onehot(y)) / N
+ */
+class CrossEntropy : public Loss {
+public:
+  CrossEntropy();
+  ~CrossEntropy() = default;
+
+  /**
+   * Forward pass of the CrossEntropy loss function.
+   *
+   * @param[out] loss mean negative log-likelihood of the target classes
+   * @param[in] y target class indices in format [N, 1]
+   * @param[in] yPred logits obtained by the neural network
+   */
+  void forward(float &loss, const Eigen::MatrixXf &y,
+               const Eigen::MatrixXf &yPred) override;
+
+  /**
+   * Backward pass of the CrossEntropy loss function.
+   *
+   * @param[out] dloss (Softmax(yPred) - onehot(y))/N, with N the number of
+   * samples
+   * @param[in] y target class indices in format [N, 1]
+   * @param[in] yPred logits obtained by the neural network
+   */
+  void backward(Eigen::MatrixXf &dloss, const Eigen::MatrixXf &y,
+                const Eigen::MatrixXf &yPred) override;
+
+  /* Print description of CrossEntropy loss class */
+  void printDescription() override;
+
+  std::string getName() override;
+
+  bool takesClassLabels() override { return true; }
+
+private:
+  std::string _type = "Loss";
+  std::string _name = "CrossEntropy";
+  // per-row max / sum, reused across steps
+  Eigen::VectorXf _row_stat;
+};
+}; // namespace Losses
+}; // namespace DeepLearningFramework
@@ -0,0 +1,51 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Interface class for all the losses
+ */
+
+#pragma once
+
+#include <Eigen/Dense>
+#include <string>
+
+namespace DeepLearningFramework {
+namespace Losses {
+class Loss {
+public:
+  virtual ~Loss() = default;
+
+  virtual void forward(float &loss, const Eigen::MatrixXf &y,
+                       const Eigen::MatrixXf &y_pred) = 0;
+
+  virtual void backward(Eigen::MatrixXf &dloss, const Eigen::MatrixXf &y,
+                        const Eigen::MatrixXf &y_pred) = 0;
+
+  virtual void printDescription() = 0;
+
+  virtual std::string getName() = 0;
+
+  /* Whether y is given as class indices [N, 1] instead of one-hot [N, C] */
+  virtual bool takesClassLabels() { return false; }
+};
+}; // namespace Losses
+}; // namespace DeepLearningFramework
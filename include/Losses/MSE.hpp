@@ -25,7 +25,7 @@
 
 #pragma once
 
-#include "Module.hpp"
+#include "Loss.hpp"
 
 #include <iostream>
 
@@ -37,7 +37,7 @@ namespace Losses {
  * forward: output = input if input > 0, else 0
  * backward: output = 1*input if forward input was > 0, else 0
  */
-class MSE {
+class MSE : public Loss {
 public:
   MSE();
   ~MSE() = default;
@@ -50,7 +50,7 @@ public:
    * @param[in] yPred values obtained by the neural network
    */
   void forward(float &loss, const Eigen::MatrixXf &y,
-               const Eigen::MatrixXf &yPred);
+               const Eigen::MatrixXf &yPred) override;
 
   /**
    * Backward pass of the MSE loss function.
@@ -60,12 +60,12 @@ public:
    * @param[in] yPred values obtained by the neural network
    */
   void backward(Eigen::MatrixXf &dloss, const Eigen::MatrixXf &y,
-                const Eigen::MatrixXf &yPred);
+                const Eigen::MatrixXf &yPred) override;
 
   /* Print description of MSE loss class */
-  void printDescription();
+  void printDescription() override;
 
-  std::string getName();
+  std::string getName() override;
 
 private:
   std::string _type = "Loss";
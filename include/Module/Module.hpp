@@ -26,8 +26,89 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <Eigen/SparseCore>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
 
 namespace DeepLearningFramework {
+/* Batch of sparse samples, one CSR row per sample. */
+using SparseBatch = Eigen::SparseMatrix<float, Eigen::RowMajor>;
+
+/* Batch of categorical ids, [batch, fields], exact beyond 2^24 unlike ids
+ * stored as float. */
+using IdBatch = Eigen::Matrix<int64_t, Eigen::Dynamic, Eigen::Dynamic>;
+
+/**
+ * Row-sparse gradient of a parameter viewed as row-major [rows, width]: only
+ * the rows listed carry a gradient, and only their values are stored, so
+ * memory, optimizer work and traffic scale with the rows a batch touches.
+ */
+struct SparseGradient {
+  Eigen::Index width = 0;
+  // sorted rows carrying a gradient
+  std::vector<int64_t> rows;
+  // [rows.size(), width] row-major values of those rows
+  std::vector<float> values;
+
+  /**
+   * Add rows to the gradient, the new ones starting from zero.
+   *
+   * @param[in] added sorted, distinct rows
+   * @param[in] keep keep the rows already present (accumulation), otherwise
+   * the gradient only holds the added rows afterwards
+   */
+  void addRows(const std::vector<int64_t> &added, bool keep) {
+    if (!keep) {
+      rows = added;
+      values.assign(rows.size() * width, 0.f);
+      return;
+    }
+    std::vector<int64_t> merged;
+    std::set_union(rows.begin(), rows.end(), added.begin(), added.end(),
+                   std::back_inserter(merged));
+    if (merged.size() == rows.size()) {
+      return;
+    }
+    std::vector<float> grown(merged.size() * width, 0.f);
+    for (size_t k = 0, j = 0; k < rows.size(); k++, j++) {
+      while (merged[j] != rows[k]) {
+        j++;
+      }
+      std::copy_n(&values[k * width], width, &grown[j * width]);
+    }
+    rows.swap(merged);
+    values.swap(grown);
+  }
+
+  /* Values of a row, which must be listed. */
+  float *row(int64_t r) {
+    const size_t k =
+        std::lower_bound(rows.begin(), rows.end(), r) - rows.begin();
+    return &values[k * width];
+  }
+};
+
+/**
+ * A trainable tensor and its gradient, both contiguous float buffers owned
+ * by a module.
+ */
+struct Parameter {
+  float *value;
+  // dense gradient, nullptr for a row-sparse one
+  float *grad;
+  Eigen::Index size;
+  // whether decoupled weight decay applies (weights yes, biases no)
+  bool decay;
+  // row-sparse gradient: when set, value is row-major with sparse->width
+  // columns and only the rows of the gradient are updated
+  SparseGradient *sparse;
+  // gradients already exchanged across ranks by the module, e.g. a table
+  // sharded across ranks
+  bool exchanged;
+};
+
 class Module {
 public:
   virtual ~Module() = default;
@@ -37,11 +118,58 @@ public:
   virtual void backward(Eigen::MatrixXf &ddout,
                         const Eigen::MatrixXf &dout) = 0;
 
+  /* Forward pass on a sparse batch, densified unless overridden. */
+  virtual void forwardSparse(Eigen::MatrixXf &out, const SparseBatch &x) {
+    forward(out, Eigen::MatrixXf(x));
+  }
+
+  /* Inference-only forward pass on a sparse batch. */
+  virtual void predictSparse(Eigen::MatrixXf &out, const SparseBatch &x) {
+    predict(out, Eigen::MatrixXf(x));
+  }
+
+  /* Forward pass on a batch of ids, converted to float unless overridden. */
+  virtual void forwardIds(Eigen::MatrixXf &out, const IdBatch &x) {
+    forward(out, x.cast<float>());
+  }
+
+  /* Inference-only forward pass on a batch of ids. */
+  virtual void predictIds(Eigen::MatrixXf &out, const IdBatch &x) {
+    predict(out, x.cast<float>());
+  }
+
+  /* Inference-only forward pass, keeps no state for backward. */
+  virtual void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+    forward(out, x);
+  }
+
+  /* Calibrate int8 inference on a sample of this module's inputs. */
+  virtual void quantize(const Eigen::MatrixXf &x) {}
+
+  /* Return to fp32 inference. */
+  virtual void dequantize() {}
+
   virtual void printDescription() = 0;
 
-  virtual void setLR(float lr) = 0;
+  /* Append the trainable parameters of this module. */
+  virtual void collectParameters(std::vector<Parameter> &parameters) {}
+
+  /* Sum gradients over the following backward passes instead of overwriting
+   * them, see Sequential::setGradientAccumulation. */
+  virtual void accumulateGradients(bool accumulate) {}
+
+  /* Called once the parameters changed, by an optimizer step or a pull from
+   * rank 0, e.g. to refresh copies derived from them. */
+  virtual void parametersChanged() {}
 
-  virtual uint32_t getParametersCount() = 0;
+  /* Whether the module exchanges its own gradients across data parallel
+   * ranks, in which case its output gradient is kept local. */
+  virtual bool exchangesGradients() { return false; }
+
+  virtual int64_t getParametersCount() = 0;
   virtual std::string getName() = 0;
+
+  /* Bytes held by the activations saved for the backward pass. */
+  virtual size_t getSavedActivationBytes() { return 0; }
 };
 }; // namespace DeepLearningFramework
@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Adam optimizer class definition
+ */
+
+#pragma once
+
+#include "Optimizer.hpp"
+
+#include <iostream>
+
+namespace DeepLearningFramework {
+namespace Optimizers {
+/**
+ * Optimizer class: Adam.
+ *
+ * m = beta1 * m + (1 - beta1) * grad
+ * v = beta2 * v + (1 - beta2) * grad^2
+ * value -= lr * (m / (1 - beta1^t)) / (sqrt(v / (1 - beta2^t)) + eps)
+ */
+class Adam : public Optimizer {
+public:
+  explicit Adam(float lr = 0.001f, float beta1 = 0.9f, float beta2 = 0.999f,
+                float eps = 1e-8f);
+  ~Adam() = default;
+
+  void printDescription() override;
+
+  std::string getName() override;
+
+protected:
+  void beginStep() override;
+
+  void update(float *value, const float *grad, Eigen::Index offset,
+              Eigen::Index count, bool decay) override;
+
+  void resetState(Eigen::Index total) override;
+
+  std::string _name = "Adam";
+  float _beta1;
+  float _beta2;
+  float _eps;
+  // bias corrections of the current step
+  float _correction1 = 1.f;
+  float _correction2 = 1.f;
+  Eigen::ArrayXf _m;
+  Eigen::ArrayXf _v;
+};
+}; // namespace Optimizers
+}; // namespace DeepLearningFramework
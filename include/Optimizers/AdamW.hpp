@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * AdamW optimizer class definition
+ */
+
+#pragma once
+
+#include "Adam.hpp"
+
+namespace DeepLearningFramework {
+namespace Optimizers {
+/**
+ * Optimizer class: AdamW, Adam with decoupled weight decay.
+ *
+ * value -= lr * weight_decay * value (weights only, not biases)
+ * then the Adam update.
+ */
+class AdamW : public Adam {
+public:
+  explicit AdamW(float lr = 0.001f, float weight_decay = 0.01f,
+                 float beta1 = 0.9f, float beta2 = 0.999f, float eps = 1e-8f);
+  ~AdamW() = default;
+
+  void printDescription() override;
+
+protected:
+  void update(float *value, const float *grad, Eigen::Index offset,
+              Eigen::Index count, bool decay) override;
+
+private:
+  float _weight_decay;
+};
+}; // namespace Optimizers
+}; // namespace DeepLearningFramework
@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Interface class for all the optimizers
+ */
+
+#pragma once
+
+#include "Module.hpp"
+
+#include <string>
+#include <vector>
+
+namespace DeepLearningFramework {
+namespace Optimizers {
+/**
+ * Optimizer class.
+ *
+ * Updates every registered parameter from its gradient. step() treats all
+ * parameters as one flat index space and makes a single fused pass over
+ * parameters, gradients and optimizer state, split across threads, instead
+ * of one small expression per matrix. Row-sparse parameters (see Parameter)
+ * only update the rows present in their gradient, leaving the state of the
+ * other rows untouched (lazy updates).
+ */
+class Optimizer {
+public:
+  explicit Optimizer(float lr) : _lr(lr) {}
+  virtual ~Optimizer() = default;
+
+  /**
+   * Register the parameters to update and reset the optimizer state.
+   *
+   * @param[in] parameters parameters of the model
+   */
+  void setParameters(const std::vector<Parameter> &parameters);
+
+  /**
+   * Apply one update to all registered parameters.
+   *
+   * @param[in] grad_scale factor applied to the gradients first, e.g. 1/K
+   * after accumulating K micro-batches
+   */
+  void step(float grad_scale = 1.f);
+
+  /**
+   * Set learning rate.
+   *
+   * @param[in] lr learning rate to use.
+   */
+  void setLR(float lr) { _lr = lr; }
+
+  float getLR() { return _lr; }
+
+  virtual void printDescription() = 0;
+
+  virtual std::string getName() = 0;
+
+protected:
+  /* Called once per step before any update, e.g. for bias corrections. */
+  virtual void beginStep() {}
+
+  /**
+   * Update a contiguous slice of one parameter.
+   *
+   * @param[in/out] value slice of the parameter
+   * @param[in] grad matching slice of its gradient
+   * @param[in] offset position of value[0] in the flat state
+   * @param[in] count number of elements
+   * @param[in] decay whether weight decay applies to this parameter
+   */
+  virtual void update(float *value, const float *grad, Eigen::Index offset,
+                      Eigen::Index count, bool decay) = 0;
+
+  /* Allocate per-element state for `total` elements. */
+  virtual void resetState(Eigen::Index total) {}
+
+  float _lr;
+  int _step = 0;
+
+private:
+  /* Scale the gradient of the slice of parameter i at local, then update
+   * the slice. */
+  void updateSlice(size_t i, Eigen::Index local, float *grad,
+                   Eigen::Index count, float grad_scale);
+
+  std::vector<Parameter> _parameters;
+  // _offsets[i] is the flat position of parameter i, _offsets.back() = total
+  std::vector<Eigen::Index> _offsets;
+  // dense parameters and their positions in the flat dense index space
+  std::vector<size_t> _dense;
+  std::vector<Eigen::Index> _dense_offsets;
+  // row-sparse parameters
+  std::vector<size_t> _sparse;
+};
+}; // namespace Optimizers
+}; // namespace DeepLearningFramework
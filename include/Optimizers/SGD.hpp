@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * SGD optimizer class definition
+ */
+
+#pragma once
+
+#include "Optimizer.hpp"
+
+#include <iostream>
+
+namespace DeepLearningFramework {
+namespace Optimizers {
+/**
+ * Optimizer class: SGD with momentum.
+ *
+ * velocity = momentum * velocity + grad
+ * value -= lr * velocity
+ *
+ * With momentum = 0 no state is kept and value -= lr * grad.
+ */
+class SGD : public Optimizer {
+public:
+  explicit SGD(float lr = 0.01f, float momentum = 0.f);
+  ~SGD() = default;
+
+  void printDescription() override;
+
+  std::string getName() override;
+
+protected:
+  void update(float *value, const float *grad, Eigen::Index offset,
+              Eigen::Index count, bool decay) override;
+
+  void resetState(Eigen::Index total) override;
+
+private:
+  std::string _name = "SGD";
+  float _momentum;
+  Eigen::ArrayXf _velocity;
+};
+}; // namespace Optimizers
+}; // namespace DeepLearningFramework
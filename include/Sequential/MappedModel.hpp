@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * MappedModel class definition and model file layout
+ */
+
+#pragma once
+
+#include "Module.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace DeepLearningFramework {
+/**
+ * Model file written by Sequential::save:
+ *
+ *   ModelFileHeader
+ *   ModelFileRecord x module_count, in model order
+ *   fp32 blobs, each at a 64-byte aligned offset
+ *
+ * Weights are stored in the in-memory layout of the layer, [input, output]
+ * column-major ([output, input] for SparseLinear), biases as [1, output].
+ * Values are in host byte order.
+ */
+struct ModelFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t module_count;
+};
+
+struct ModelFileRecord {
+  // module name as returned by getName()
+  char name[16];
+  uint32_t input_size;
+  uint32_t output_size;
+  // file offsets of the weights and bias blobs, 0 for modules without them
+  uint64_t weights_offset;
+  uint64_t bias_offset;
+};
+
+constexpr char kModelFileMagic[8] = {'P', 'P', 'B', 'L', 'M', 'O', 'D', 'L'};
+// version 2 adds the biases, version 1 subtracted them
+constexpr uint32_t kModelFileVersion = 2;
+constexpr size_t kModelFileAlignment = 64;
+
+/**
+ * MappedModel class
+ *
+ * Inference-only model loaded from a file written by Sequential::save. The
+ * file is mmap-ed read-only and the layers compute straight from the mapped
+ * weights, so loading neither parses nor copies them, and processes on the
+ * same host mapping the same file share its pages.
+ *
+ * predict: apply the model to a batch, like Sequential::forward(x, "predict")
+ */
+class MappedModel {
+public:
+  explicit MappedModel(const std::string &path);
+
+  /**
+   * Model from a file image in memory, e.g. written by Sequential::save to a
+   * stream. The image is copied into a private anonymous mapping.
+   *
+   * @param[in] image file contents
+   * @param[in] size size of image in bytes
+   */
+  MappedModel(const char *image, size_t size);
+  ~MappedModel();
+
+  MappedModel(const MappedModel &) = delete;
+  MappedModel &operator=(const MappedModel &) = delete;
+
+  /** Whether the file was mapped and is a valid model file. */
+  bool isLoaded() { return _data != nullptr; }
+
+  /**
+   * Apply the model.
+   *
+   * @param[out] out model output
+   * @param[in] x [batch, input] features
+   */
+  void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x);
+
+  /* Print description of each layer in sequence */
+  void printDescription();
+
+private:
+  struct Layer {
+    std::string name;
+    int input_size;
+    int output_size;
+    const float *weights;
+    const float *bias;
+    // activations run through their Module::predict
+    std::unique_ptr<Module> activation;
+  };
+
+  /* Check the file and build the layers, false if it is not valid. */
+  bool parse(const std::string &path);
+
+  void *_data = nullptr;
+  size_t _size = 0;
+  std::vector<Layer> _layers;
+};
+}; // namespace DeepLearningFramework
@@ -25,14 +25,32 @@
 
 #pragma once
 
-#include "MSE.hpp"
+#include "Loss.hpp"
 #include "Module.hpp"
+#include "Optimizer.hpp"
+#include "SGD.hpp"
 
 #include <iostream>
 #include <string>
 #include <vector>
 
 namespace DeepLearningFramework {
+/**
+ * Per-model buffers reused across training steps. Each buffer takes its shape
+ * on the first step; later steps with the same shapes reuse the storage, so
+ * a steady-state step does not touch the heap.
+ */
+struct Workspace {
+  // output of module m
+  std::vector<Eigen::MatrixXf> activations;
+  // gradient w.r.t. the input of module m
+  std::vector<Eigen::MatrixXf> gradients;
+  // gradient of the loss w.r.t. the model output
+  Eigen::MatrixXf loss_gradient;
+  // pipeline stage input/gradient exchanged with the neighbouring rank
+  Eigen::MatrixXf boundary;
+};
+
 /**
  * Sequential class.
  *
@@ -40,11 +58,13 @@ namespace DeepLearningFramework {
  *
  * forward: apply forward pass for each module in sequence
  * backward: calculate loss and apply backward pass for each layer in reverse
- * order.
+ * order, then update all parameters with the optimizer (plain SGD unless
+ * setOptimizer is called). With gradient accumulation the update, and in
+ * data parallelism the gradient exchange, happen once every K backward calls.
  */
 class Sequential {
 public:
-  Sequential(std::vector<Module *> &model, Losses::MSE loss);
+  Sequential(std::vector<Module *> &model, Losses::Loss &loss);
   ~Sequential() {
     std::vector<Module *>::iterator it;
     for (it = _model.begin(); it != _model.end(); it++)
@@ -56,9 +76,45 @@ public:
    *
    * @param[in/out] x data on which to apply the model (all layers in sequence).
    * Modified with neural network result
+   * @param[in] mode "train", "predict" (no state kept for backward) or
+   * "calibrate" (predict while quantizing each module, see quantize)
    */
   void forward(Eigen::MatrixXf &x, const std::string &mode = "train");
 
+  /**
+   * Apply forward pass for each layer in sequence.
+   *
+   * @param[out] out neural network result
+   * @param[in] x data on which to apply the model (all layers in sequence).
+   * @param[in] mode see forward(x, mode)
+   */
+  void forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x,
+               const std::string &mode = "train");
+
+  /**
+   * Apply forward pass on a sparse batch. In data parallelism only the first
+   * module (e.g. a Layers::SparseLinear) sees the CSR batch; otherwise the
+   * batch is densified.
+   *
+   * @param[out] out neural network result
+   * @param[in] x CSR batch, one row per sample
+   * @param[in] mode see forward(x, mode)
+   */
+  void forward(Eigen::MatrixXf &out, const SparseBatch &x,
+               const std::string &mode = "train");
+
+  /**
+   * Apply forward pass on a batch of integer ids. In data parallelism only
+   * the first module (e.g. a Layers::Embedding) sees the ids; otherwise they
+   * are converted to float.
+   *
+   * @param[out] out neural network result
+   * @param[in] x [batch, fields] ids
+   * @param[in] mode see forward(x, mode)
+   */
+  void forward(Eigen::MatrixXf &out, const IdBatch &x,
+               const std::string &mode = "train");
+
   /**
    * Calculate loss and apply backward pass for each layer in reverse order.
    *
@@ -68,27 +124,109 @@ public:
    */
   void backward(float &loss, const Eigen::MatrixXf &y, Eigen::MatrixXf &y_pred);
 
+  /**
+   * Switch "predict" forward passes to int8 inference, calibrated by running
+   * a sample batch through the model. Re-run after further training.
+   *
+   * @param[in] x sample batch of features
+   */
+  void quantize(const Eigen::MatrixXf &x);
+
+  /* Switch "predict" forward passes back to fp32 */
+  void dequantize();
+
+  /**
+   * Export the modules held by this rank (the whole model except in pipeline
+   * mode) with their fp32 weights, for loading with MappedModel.
+   *
+   * @param[in] path file to write
+   * @return false if the file cannot be written or a module cannot be
+   * exported (only Linear, SparseLinear and the activations can)
+   */
+  bool save(const std::string &path);
+
+  /* Write the same file image to a stream, e.g. to snapshot the weights */
+  bool save(std::ostream &file);
+
   /* Print description of each module in sequence */
   void printDescription();
 
   /**
-   * Set learning rate used to update weights for all modules
+   * Set the learning rate of the optimizer, which updates every module
    *
    * @param[in] lr learning rate to use.
    */
   void setLR(float lr);
 
+  /**
+   * Update parameters with the given optimizer instead of plain SGD. The
+   * optimizer must outlive the model.
+   *
+   * @param[in] optimizer optimizer to use.
+   */
+  void setOptimizer(Optimizers::Optimizer &optimizer);
+
+  /**
+   * Accumulate parameter gradients over `steps` micro-batches before each
+   * update, for an effective batch of steps * batch size with the activation
+   * memory of a single batch. In data parallelism the ranks then exchange
+   * accumulated parameter gradients once per update instead of activation
+   * gradients on every step.
+   *
+   * @param[in] steps number of micro-batches per update, 1 to disable.
+   */
+  void setGradientAccumulation(int steps);
+
+  /* Apply the gradients accumulated so far, e.g. at the end of an epoch. */
+  void flushGradients();
+
+  /**
+   * Whether a module exchanges data with the other ranks in every step (e.g.
+   * a sharded Layers::Embedding or a normalization layer), so data parallel
+   * ranks must run the same number of steps.
+   */
+  bool exchangesGradients();
+
+  /** Whether the loss expects class indices instead of one-hot labels. */
+  bool takesClassLabels();
+
   /** Get the number of parameters of the model. */
-  uint32_t getParametersCount();
+  int64_t getParametersCount();
+
+  /** Bytes held by all activations saved for the backward pass. */
+  size_t getSavedActivationBytes();
 
   std::string getName();
 
 private:
+  /* Fetch the parameters of rank 0 at the start of a data parallel step. */
+  void syncParameters();
+
+  /* Exchange accumulated gradients if needed and update the parameters. */
+  void applyAccumulatedGradients();
+
+  /* Tell every module that its parameters changed. */
+  void parametersChanged();
+
+  /* Sum parameter gradients into rank 0, on the background thread in ASYNC
+   * mode. */
+  void pushParameterGradients(std::vector<Parameter> &parameters);
+
   // type, name, neural network
   std::string _type = "Module";
   std::string _name = "Sequential";
   std::vector<Module *> _model;
-  Losses::MSE _loss;
+  Losses::Loss *_loss;
+  Optimizers::SGD _default_optimizer;
+  Optimizers::Optimizer *_optimizer;
+  std::vector<Parameter> _parameters;
+  // per module, its parameters when they hold a row-sparse gradient that
+  // data parallel ranks exchange after every backward pass, else empty
+  std::vector<std::vector<Parameter>> _sparse_parameters;
+  // micro-batches per update and backward calls since the last update
+  int _accumulation_steps = 1;
+  int _micro_step = 0;
+  Workspace _workspace;
   int _forward_flag;
   int _backward_flag;
 };
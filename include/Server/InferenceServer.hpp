@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * InferenceServer class definition
+ */
+
+#pragma once
+
+#include "Sequential.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace DeepLearningFramework {
+struct ServerOptions {
+  // listen on this Unix socket when set, else on TCP port of 127.0.0.1
+  std::string unix_path;
+  int port = 5555;
+  // largest batch run through the model
+  int max_batch_size = 64;
+  // longest time the first request of a batch waits for others
+  double max_latency_ms = 2.0;
+  // seconds between two statistics reports, 0 to disable
+  double report_interval_s = 10.0;
+};
+
+struct ServerStats {
+  uint64_t requests = 0;
+  uint64_t batches = 0;
+  // request latency from arrival to response, in milliseconds
+  double p50_ms = 0.0;
+  double p99_ms = 0.0;
+  // requests per second since the server started
+  double throughput = 0.0;
+};
+
+/**
+ * InferenceServer class
+ *
+ * Serves predictions of a trained model over a local socket. Each request is
+ * one line holding the features of one sample, separated by commas or
+ * spaces; the response is one line with the model output. The line
+ * "shutdown" stops the server.
+ *
+ * Concurrent requests are gathered into batches of up to max_batch_size
+ * samples, waiting at most max_latency_ms after the first one, and each
+ * batch goes through the model as one "predict" forward pass.
+ *
+ * In pipeline model parallelism rank 0 accepts requests and streams batches
+ * through the stages: it keeps feeding new batches while earlier ones are in
+ * later stages, and the last stage returns the outputs to rank 0. Every rank
+ * must call serve(). Otherwise only rank 0 serves and serve() returns at
+ * once on the other ranks.
+ */
+class InferenceServer {
+public:
+  InferenceServer(Sequential &model, int feature_dim,
+                  const ServerOptions &options = ServerOptions());
+  ~InferenceServer();
+
+  /* Serve requests until stop() is called or a client sends "shutdown". */
+  void serve();
+
+  /* Stop serving, may be called from any thread. */
+  void stop();
+
+  /* Latency and throughput of the requests served so far. */
+  ServerStats stats();
+
+private:
+  struct Request {
+    std::vector<float> features;
+    std::promise<std::vector<float>> response;
+    std::chrono::steady_clock::time_point arrival;
+  };
+  using Batch = std::vector<std::shared_ptr<Request>>;
+
+  /* Accept connections and start a reader for each. */
+  void acceptLoop(int listen_fd);
+
+  /* Read the requests of one connection and write their responses. */
+  void connectionLoop(int fd);
+
+  /* Next batch, or an empty one after `wait` without requests. */
+  Batch nextBatch(std::chrono::milliseconds wait);
+
+  /* Fulfil the requests of a batch with the rows of the model output. */
+  void complete(Batch &batch, const Eigen::MatrixXf &out);
+
+  /* Stack the features of a batch into one matrix. */
+  Eigen::MatrixXf stack(const Batch &batch);
+
+  /* Rank 0 in pipeline mode: keep batches in flight through the stages. */
+  void servePipeline();
+
+  /* Ranks past 0 in pipeline mode: run this stage until the empty batch. */
+  void serveStage();
+
+  /* Receive the output of the oldest batch in flight from the last stage. */
+  void receiveResult(std::deque<Batch> &in_flight);
+
+  /* Log the statistics every report_interval_s seconds, or now if forced. */
+  void report(bool force = false);
+
+  int openSocket();
+
+  Sequential &_model;
+  int _feature_dim;
+  ServerOptions _options;
+  std::atomic<bool> _stop;
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::deque<std::shared_ptr<Request>> _queue;
+  std::vector<std::thread> _threads;
+  // live connection threads, guarded by _mutex
+  int _connections = 0;
+
+  // statistics
+  std::mutex _stats_mutex;
+  // the most recent latencies, for the percentiles
+  std::vector<double> _latencies_ms;
+  uint64_t _requests = 0;
+  uint64_t _batches = 0;
+  std::chrono::steady_clock::time_point _start;
+  std::chrono::steady_clock::time_point _last_report;
+};
+}; // namespace DeepLearningFramework
@@ -0,0 +1,164 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Evaluator class definition
+ */
+
+#pragma once
+
+#include "DataLoader.hpp"
+#include "MappedModel.hpp"
+#include "Sequential.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace DeepLearningFramework {
+struct EvaluationOptions {
+  // rows per "predict" pass, which bounds the activation memory
+  Eigen::Index chunk_rows = 4096;
+  // fraction of the samples scored, a new random subset in every round
+  float sample_fraction = 1.f;
+  // score a snapshot of the weights on a background thread while training
+  // goes on (its allocations then show in the per-step allocation count)
+  bool async = false;
+};
+
+inline EvaluationOptions &globalEvaluationOptions() {
+  static EvaluationOptions global_evaluation_options;
+  return global_evaluation_options;
+}
+
+/**
+ * Evaluator class
+ *
+ * Accuracy of a model over several splits, one round at a time:
+ *
+ *   evaluator.snapshot(model);
+ *   evaluator.evaluate(y_test, X_test);
+ *   std::vector<float> accuracy = evaluator.collect();
+ *
+ * Each rank scores the samples it holds, in "predict" passes of at most
+ * chunk_rows rows, and collect() sums the correct and scored counts of all
+ * splits over the ranks in a single allreduce. In data parallelism the ranks
+ * hold disjoint shards, so every rank gets the accuracy over all of them.
+ * Models exchanging data in "predict" passes (a sharded Layers::Embedding)
+ * need the same number of rows on every rank, as the equal shards of
+ * DataLoader and BatchStream have.
+ *
+ * With async, a model that runs on each rank alone (data parallelism or a
+ * single process) and that Sequential::save can export is scored through a
+ * MappedModel of its fp32 weights, on a background thread; other models are
+ * scored synchronously.
+ */
+class Evaluator {
+public:
+  explicit Evaluator(
+      const EvaluationOptions &options = globalEvaluationOptions());
+  ~Evaluator();
+
+  Evaluator(const Evaluator &) = delete;
+  Evaluator &operator=(const Evaluator &) = delete;
+
+  /**
+   * Start a round on the current weights of a model, which later training
+   * steps no longer change in async mode.
+   *
+   * @param[in] model model to score, which must outlive the round
+   */
+  void snapshot(Sequential &model);
+
+  /**
+   * Queue the accuracy on a split; with sample_fraction, on a random subset
+   * of its rows.
+   *
+   * @param[in] labels class labels, empty on ranks without labels
+   * @param[in] features features, which must outlive the round
+   */
+  void evaluate(const Eigen::MatrixXf &labels,
+                const Eigen::MatrixXf &features);
+
+  /**
+   * Queue the accuracy over one pass of a stream; with sample_fraction, over
+   * its first batches (a random subset when the stream shuffles).
+   *
+   * @param[in] stream stream not used elsewhere until collect()
+   */
+  void evaluate(BatchStream &stream);
+
+  /**
+   * Queue an accuracy counted elsewhere, e.g. over training steps.
+   *
+   * @param[in] correct number of correct predictions
+   * @param[in] rows number of scored rows
+   */
+  void add(int64_t correct, int64_t rows);
+
+  /**
+   * Wait for the round and end it. Collective.
+   *
+   * @return accuracy of each queued split over all ranks, in order
+   */
+  std::vector<float> collect();
+
+  /** Whether the round is scored on a background thread. */
+  bool isAsync() const { return _snapshot != nullptr; }
+
+  /** Whether a round was started and not yet collected. */
+  bool isPending() const { return _model != nullptr; }
+
+private:
+  // correct predictions and scored rows of one split
+  struct Count {
+    int64_t correct;
+    int64_t rows;
+  };
+
+  /* Score a split with the model or its snapshot */
+  void score(Count &count, const Eigen::MatrixXf &labels,
+             const Eigen::MatrixXf &features, uint32_t draw);
+  void score(Count &count, BatchStream &stream);
+
+  /* Run job after the previous background one, in order */
+  template <typename Job> void schedule(const Job &job);
+
+  /* Predict a chunk with the model or its snapshot */
+  void predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x);
+
+  EvaluationOptions _options;
+  Sequential *_model = nullptr;
+  std::unique_ptr<MappedModel> _snapshot;
+  // background jobs write into their Count, so elements must not move
+  std::deque<Count> _counts;
+  std::thread _worker;
+  // random subsets drawn so far, the same sequence on every rank
+  uint32_t _draws = 0;
+  // chunk buffers of the current job
+  Eigen::MatrixXf _chunk;
+  Eigen::MatrixXf _chunk_labels;
+  Eigen::MatrixXf _chunk_pred;
+  std::vector<int64_t> _order;
+};
+}; // namespace DeepLearningFramework
@@ -25,6 +25,8 @@
 
 #pragma once
 
+#include "DataLoader.hpp"
+#include "Evaluator.hpp"
 #include "Metrics.hpp"
 #include "Sequential.hpp"
 
@@ -32,7 +34,7 @@ namespace DeepLearningFramework {
 /**
  * Trainer class
  *
- * trainModel: train a model
+ * trainModel: train a model, on in-memory or streamed data
  */
 class Trainer {
 public:
@@ -42,7 +44,12 @@ public:
   /**
    * trainModel static method
    *
-   * Train a model for n epoch on specified data
+   * Train a model for n epoch on specified data. Every epoch shuffles the
+   * samples into contiguous batches (one more copy of the train set,
+   * allocated once) that steps pass to the model as they are; the trailing
+   * rows make a last, smaller batch. After each epoch an Evaluator
+   * with globalEvaluationOptions() scores both sets; when it runs in the
+   * background, an epoch is logged once the next one has trained.
    *
    * @param[out] train_loss loss from epoch 0 to epochsCount on train set
    * @param[out] train_acc accuracy from epoch 0 to epochsCount on
@@ -67,20 +74,51 @@ public:
              const Eigen::MatrixXf &X_train, const Eigen::MatrixXf &y_test,
              const Eigen::MatrixXf &X_test, uint32_t step);
 
-private:
   /**
-   * Calculate and add current accuracy to history
+   * trainModel static method
    *
-   * Train a model for n epoch on specified data
+   * Train a model for n epoch on batches streamed from part files, without
+   * ever holding a whole split. The train accuracy of an epoch is the
+   * running accuracy of its training batches; the test set is streamed once
+   * per epoch, by an Evaluator as above.
+   *
+   * @param[out] train_acc accuracy from epoch 0 to epochsCount on
+   * train set
+   * @param[out] test_acc accuracy from epoch 0 to epochsCount on
+   * test set
+   * @param[in/out] model to train
+   * @param[in] epochs number of epochs
+   * @param[in] train train set, its labels encoded by the stream
+   * @param[in] test test set
+   * @param[in] step display loss and metrics every N epochs
+   */
+  static void trainModel(std::vector<float> &train_acc,
+                         std::vector<float> &test_acc, Sequential &model,
+                         uint32_t epochs, BatchStream &train,
+                         BatchStream &test, uint32_t step);
+
+private:
+  /* What an epoch logs once its accuracy is known */
+  struct EpochReport {
+    uint32_t epoch;
+    float loss;
+    double train_ms;
+    size_t max_step_allocations;
+  };
+
+  /**
+   * Collect the evaluation round of an epoch, add its train and test
+   * accuracy to history and log it every step epochs
    *
-   * @param[out] accuracyHistory vector in which to add the accuracy
-   * @param[in] model model to score wit haccuracy metric
-   * @param[in] labels labels
-   * @param[in] features features
+   * @param[in/out] evaluator evaluator with the round of the epoch
+   * @param[in] report epoch to log
+   * @param[out] train_acc vector in which to add the train accuracy
+   * @param[out] test_acc vector in which to add the test accuracy
+   * @param[in] step log every N epochs
    */
-  static void addAccuracy(std::vector<float> &accuracyHistory,
-                          Sequential &model, const Eigen::MatrixXf &labels,
-                          const Eigen::MatrixXf &features);
+  static void reportEpoch(Evaluator &evaluator, const EpochReport &report,
+                          std::vector<float> &train_acc,
+                          std::vector<float> &test_acc, uint32_t step);
 };
 }; // namespace DeepLearningFramework
 
@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Identity activation class implementation
+ */
+
+#include "Identity.hpp"
+
+#include <iostream>
+
+using namespace DeepLearningFramework::Activations;
+
+Identity::Identity() {}
+
+void Identity::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  if (&out != &x) {
+    out = x;
+  }
+}
+
+void Identity::backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) {
+  if (&din != &dout) {
+    din = dout;
+  }
+}
+
+void Identity::printDescription() {
+  std::cout << "Identity activation" << std::endl;
+}
+
+std::string Identity::getName() { return _name; }
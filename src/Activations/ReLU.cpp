@@ -24,7 +24,9 @@
  */
 
 #include "ReLU.hpp"
+#include "Parallel.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 using namespace DeepLearningFramework::Activations;
@@ -32,12 +34,58 @@ using namespace DeepLearningFramework::Activations;
 ReLU::ReLU() {}
 
 void ReLU::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
-  _forward_input = x;
-  out = (x.array() < 0.f).select(0.f, x);
+  const Eigen::Index size = x.size();
+  _mask.resize((size + 63) / 64);
+  out.resize(x.rows(), x.cols());
+
+  const float *in = x.data();
+  float *result = out.data();
+  uint64_t *mask = _mask.data();
+  parallelFor(_mask.size(), 64, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index word = begin; word < end; ++word) {
+      const Eigen::Index first = word * 64;
+      const Eigen::Index count = std::min<Eigen::Index>(64, size - first);
+      uint64_t bits = 0;
+      for (Eigen::Index j = 0; j < count; ++j) {
+        const float value = in[first + j];
+        bits |= static_cast<uint64_t>(!(value < 0.f)) << j;
+        result[first + j] = value < 0.f ? 0.f : value;
+      }
+      mask[word] = bits;
+    }
+  });
 }
 
 void ReLU::backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) {
-  din = (_forward_input.array() < 0.f).select(0.f, dout);
+  const Eigen::Index size = dout.size();
+  din.resize(dout.rows(), dout.cols());
+
+  const uint64_t *mask = _mask.data();
+  const float *grad = dout.data();
+  float *result = din.data();
+  parallelFor(_mask.size(), 64, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index word = begin; word < end; ++word) {
+      const Eigen::Index first = word * 64;
+      const Eigen::Index count = std::min<Eigen::Index>(64, size - first);
+      const uint64_t bits = mask[word];
+      // branch-free select, vectorized by the compiler
+      for (Eigen::Index j = 0; j < count; ++j) {
+        result[first + j] = ((bits >> j) & 1u) ? grad[first + j] : 0.f;
+      }
+    }
+  });
+}
+
+void ReLU::predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  out.resize(x.rows(), x.cols());
+
+  const float *in = x.data();
+  float *result = out.data();
+  parallelFor(x.size(), 1, [&](Eigen::Index begin, Eigen::Index end) {
+    Eigen::Map<const Eigen::ArrayXf> in_chunk(in + begin, end - begin);
+    Eigen::Map<Eigen::ArrayXf> out_chunk(result + begin, end - begin);
+    out_chunk = (in_chunk < 0.f).select(0.f, in_chunk);
+  });
 }
 
 void ReLU::printDescription() { std::cout << "ReLU activation" << std::endl; }
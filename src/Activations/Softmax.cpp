@@ -24,6 +24,7 @@
  */
 
 #include "Softmax.hpp"
+#include "Parallel.hpp"
 
 #include <iostream>
 
@@ -37,22 +38,32 @@ void Softmax::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
 }
 
 void Softmax::backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) {
+  const Eigen::MatrixXf &s = _forward_input_with_softmax_applied;
+  din.resize(dout.rows(), dout.cols());
+  if (_row_stat.size() < dout.rows()) {
+    _row_stat.resize(dout.rows());
+  }
 
-  const Eigen::MatrixXf grad = dout;
+  // Jacobian-vector product in closed form: din = s * (dout - sum(dout * s)),
+  // O(rows * cols) instead of materializing the cols x cols Jacobian per row.
+  parallelFor(dout.rows(), 3 * dout.cols(),
+              [&](Eigen::Index begin, Eigen::Index end) {
+                const Eigen::Index n = end - begin;
+                auto dot = _row_stat.segment(begin, n);
+                dot.setZero();
+                for (Eigen::Index col = 0; col < dout.cols(); ++col) {
+                  dot += dout.col(col).segment(begin, n).cwiseProduct(
+                      s.col(col).segment(begin, n));
+                }
+                din.middleRows(begin, n).array() =
+                    s.middleRows(begin, n).array() *
+                    (dout.middleRows(begin, n).array().colwise() -
+                     dot.array());
+              });
+}
 
-  for (int i = 0; i < dout.rows(); ++i) {
-    for (int j = 0; j < dout.cols(); ++j) {
-      for (int k = 0; k < dout.cols(); ++k) {
-        if (j == k) {
-          din(i, j) += grad(i, k) * _forward_input_with_softmax_applied(i, k) *
-                       (1.f - _forward_input_with_softmax_applied(i, j));
-        } else {
-          din(i, j) += grad(i, k) * _forward_input_with_softmax_applied(i, k) *
-                       (-_forward_input_with_softmax_applied(i, j));
-        }
-      }
-    }
-  }
+void Softmax::predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  Softmax::equation(out, x);
 }
 
 void Softmax::printDescription() {
@@ -60,11 +71,26 @@ void Softmax::printDescription() {
 }
 
 void Softmax::equation(Eigen::MatrixXf &y, const Eigen::MatrixXf &x) {
-  Eigen::MatrixXf exp_x = x.array().exp();
-  y = x;
-  for (int row = 0; row < x.rows(); ++row) {
-    y.row(row) = exp_x.row(row) / exp_x.row(row).sum();
+  y.resize(x.rows(), x.cols());
+  // grow only, so large predict batches do not shrink it for training
+  if (_row_stat.size() < x.rows()) {
+    _row_stat.resize(x.rows());
   }
+
+  // log-sum-exp form: shift each row by its max so exp() never overflows.
+  // Works in place on y with one per-row buffer, so nothing is allocated.
+  parallelFor(x.rows(), 4 * x.cols(),
+              [&](Eigen::Index begin, Eigen::Index end) {
+                const Eigen::Index n = end - begin;
+                auto row_stat = _row_stat.segment(begin, n);
+                row_stat = x.middleRows(begin, n).rowwise().maxCoeff();
+                y.middleRows(begin, n).array() =
+                    (x.middleRows(begin, n).array().colwise() -
+                     row_stat.array())
+                        .exp();
+                row_stat = y.middleRows(begin, n).rowwise().sum();
+                y.middleRows(begin, n).array().colwise() /= row_stat.array();
+              });
 }
 
 std::string Softmax::getName() { return _name; }
@@ -0,0 +1,636 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Dense GEMM with per-shape backend dispatch implementation
+ */
+
+#include "Gemm.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PICOPEBBLE_X86
+#endif
+
+#ifdef PICOPEBBLE_USE_BLAS
+extern "C" {
+#include <cblas.h>
+#ifdef PICOPEBBLE_OPENBLAS_THREADS
+void openblas_set_num_threads(int threads);
+char *openblas_get_config();
+#endif
+}
+#ifndef PICOPEBBLE_BLAS_NAME
+#define PICOPEBBLE_BLAS_NAME "blas"
+#endif
+#endif
+
+using namespace DeepLearningFramework;
+
+namespace {
+void eigenGemm(Eigen::MatrixXf &c, const Eigen::MatrixXf &a, bool transpose_a,
+               const Eigen::MatrixXf &b, bool transpose_b, bool accumulate) {
+  if (accumulate) {
+    if (transpose_a && transpose_b) {
+      c.noalias() += a.transpose() * b.transpose();
+    } else if (transpose_a) {
+      c.noalias() += a.transpose() * b;
+    } else if (transpose_b) {
+      c.noalias() += a * b.transpose();
+    } else {
+      c.noalias() += a * b;
+    }
+  } else {
+    if (transpose_a && transpose_b) {
+      c.noalias() = a.transpose() * b.transpose();
+    } else if (transpose_a) {
+      c.noalias() = a.transpose() * b;
+    } else if (transpose_b) {
+      c.noalias() = a * b.transpose();
+    } else {
+      c.noalias() = a * b;
+    }
+  }
+}
+
+using MatrixXi8 = Eigen::Matrix<int8_t, Eigen::Dynamic, Eigen::Dynamic>;
+using Bf16Rows = Eigen::Ref<const RowMajorMatrixXbf16>;
+using Bf16Cols = Eigen::Ref<
+    const Eigen::Matrix<Eigen::bfloat16, Eigen::Dynamic, Eigen::Dynamic>>;
+
+#ifdef PICOPEBBLE_X86
+/* x[from, to) . y[from, to) */
+int32_t dotInt8(const int8_t *x, const int8_t *y, Eigen::Index from,
+                Eigen::Index to) {
+  int32_t sum = 0;
+  for (Eigen::Index p = from; p < to; p++) {
+    sum += int32_t(x[p]) * int32_t(y[p]);
+  }
+  return sum;
+}
+
+/* sum of the 8 int32 lanes of v */
+__attribute__((target("avx2"))) int32_t sumLanes(__m256i v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+  sum = _mm_hadd_epi32(sum, sum);
+  sum = _mm_hadd_epi32(sum, sum);
+  return _mm_cvtsi128_si32(sum);
+}
+
+// Each kernel computes the R x C block of c at (i, j), c(i + r, j + s) =
+// a.row(i + r) . b.col(j + s), keeping its R * C accumulators in registers
+// and loading each chunk of a and b once for the whole block.
+
+/* 16 values per step, sign-extended to int16: madd_epi16 sums pairs of
+ * exact products into int32 lanes. */
+template <int R, int C>
+__attribute__((target("avx2"))) void
+int8BlockAvx2(Eigen::MatrixXi &c, const RowMajorMatrixXi8 &a,
+              const MatrixXi8 &b, Eigen::Index i, Eigen::Index j) {
+  const Eigen::Index k = a.cols();
+  const Eigen::Index vector_k = k / 16 * 16;
+  __m256i acc[R][C];
+  for (int r = 0; r < R; r++) {
+    for (int s = 0; s < C; s++) {
+      acc[r][s] = _mm256_setzero_si256();
+    }
+  }
+  for (Eigen::Index p = 0; p < vector_k; p += 16) {
+    __m256i x[R];
+    for (int r = 0; r < R; r++) {
+      x[r] = _mm256_cvtepi8_epi16(_mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(a.row(i + r).data() + p)));
+    }
+    for (int s = 0; s < C; s++) {
+      const __m256i y = _mm256_cvtepi8_epi16(_mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(b.col(j + s).data() + p)));
+      for (int r = 0; r < R; r++) {
+        acc[r][s] = _mm256_add_epi32(acc[r][s], _mm256_madd_epi16(x[r], y));
+      }
+    }
+  }
+  for (int r = 0; r < R; r++) {
+    for (int s = 0; s < C; s++) {
+      c(i + r, j + s) =
+          sumLanes(acc[r][s]) + dotInt8(a.row(i + r).data(),
+                                        b.col(j + s).data(), vector_k, k);
+    }
+  }
+}
+
+/* 32 values per step: dpbusd multiplies unsigned by signed bytes and sums
+ * groups of 4 products into int32 lanes without saturation. a is made
+ * unsigned by adding 128 (flipping its sign bit), which adds 128 * the sum
+ * of the column of b; b_sums removes it again. */
+template <int R, int C>
+__attribute__((target("avx2,avxvnni"))) void
+int8BlockVnni(Eigen::MatrixXi &c, const RowMajorMatrixXi8 &a,
+              const MatrixXi8 &b, const int32_t *b_sums, Eigen::Index i,
+              Eigen::Index j) {
+  const Eigen::Index k = a.cols();
+  const Eigen::Index vector_k = k / 32 * 32;
+  const __m256i flip = _mm256_set1_epi8(-128);
+  __m256i acc[R][C];
+  for (int r = 0; r < R; r++) {
+    for (int s = 0; s < C; s++) {
+      acc[r][s] = _mm256_setzero_si256();
+    }
+  }
+  for (Eigen::Index p = 0; p < vector_k; p += 32) {
+    __m256i x[R];
+    for (int r = 0; r < R; r++) {
+      x[r] = _mm256_xor_si256(
+          _mm256_loadu_si256(
+              reinterpret_cast<const __m256i *>(a.row(i + r).data() + p)),
+          flip);
+    }
+    for (int s = 0; s < C; s++) {
+      const __m256i y = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(b.col(j + s).data() + p));
+      for (int r = 0; r < R; r++) {
+        acc[r][s] = _mm256_dpbusd_avx_epi32(acc[r][s], x[r], y);
+      }
+    }
+  }
+  for (int r = 0; r < R; r++) {
+    for (int s = 0; s < C; s++) {
+      c(i + r, j + s) =
+          sumLanes(acc[r][s]) - 128 * b_sums[j + s] +
+          dotInt8(a.row(i + r).data(), b.col(j + s).data(), vector_k, k);
+    }
+  }
+}
+
+template <int R, int C>
+void int8Block(Int8Isa isa, Eigen::MatrixXi &c, const RowMajorMatrixXi8 &a,
+               const MatrixXi8 &b, const int32_t *b_sums, Eigen::Index i,
+               Eigen::Index j) {
+  if (isa == INT8_AVX_VNNI) {
+    int8BlockVnni<R, C>(c, a, b, b_sums, i, j);
+  } else {
+    int8BlockAvx2<R, C>(c, a, b, i, j);
+  }
+}
+
+/* R rows of c starting at i, 4 columns at a time. */
+template <int R>
+void int8Rows(Int8Isa isa, Eigen::MatrixXi &c, const RowMajorMatrixXi8 &a,
+              const MatrixXi8 &b, const int32_t *b_sums, Eigen::Index i) {
+  Eigen::Index j = 0;
+  for (; j + 4 <= b.cols(); j += 4) {
+    int8Block<R, 4>(isa, c, a, b, b_sums, i, j);
+  }
+  for (; j < b.cols(); j++) {
+    int8Block<R, 1>(isa, c, a, b, b_sums, i, j);
+  }
+}
+
+bool hasBf16Dot() {
+  static const bool has = __builtin_cpu_supports("avx512bf16");
+  return has;
+}
+
+/* a packed for the bf16 kernel: panels of 16 rows, and per panel one
+ * 32-bit word per row and pair of columns, so that each step loads 16 rows
+ * of a pair with one instruction. The odd last column is paired with 0, as
+ * are the rows past the end of a. */
+void packBf16Rows(std::vector<uint32_t> &packed, const Bf16Rows &a) {
+  const Eigen::Index pairs = (a.cols() + 1) / 2;
+  const Eigen::Index panels = (a.rows() + 15) / 16;
+  packed.assign(panels * pairs * 16, 0);
+  for (Eigen::Index i = 0; i < a.rows(); i++) {
+    const Eigen::bfloat16 *row = a.row(i).data();
+    uint32_t *out = packed.data() + i / 16 * pairs * 16 + i % 16;
+    for (Eigen::Index q = 0; q < a.cols() / 2; q++) {
+      std::memcpy(out + q * 16, row + 2 * q, sizeof(uint32_t));
+    }
+    if (a.cols() % 2 != 0) {
+      std::memcpy(out + (pairs - 1) * 16, row + a.cols() - 1,
+                  sizeof(Eigen::bfloat16));
+    }
+  }
+}
+
+/* One pair of values along k: dpbf16 multiplies the pairs of bf16 values
+ * in each 32-bit lane of a packed panel by a pair of b broadcast to all
+ * lanes, and adds both products to the fp32 lane. With Last set, the odd
+ * last value of each column of b pairs with 0, as in packed. */
+template <int V, int C, bool Last>
+__attribute__((target("avx512f,avx512bw,avx512bf16"),
+               always_inline)) inline void
+bf16Step(__m512 (&acc)[V][C], const uint32_t *packed, Eigen::Index pairs,
+         Eigen::Index panel, Eigen::Index q,
+         const Eigen::bfloat16 *const (&columns)[C]) {
+  __m512bh x[V];
+  for (int v = 0; v < V; v++) {
+    x[v] = (__m512bh)_mm512_loadu_si512(packed +
+                                        ((panel + v) * pairs + q) * 16);
+  }
+  for (int s = 0; s < C; s++) {
+    uint32_t pair = 0;
+    std::memcpy(&pair, columns[s] + 2 * q,
+                Last ? sizeof(Eigen::bfloat16) : sizeof(uint32_t));
+    const __m512bh y = (__m512bh)_mm512_set1_epi32(static_cast<int>(pair));
+    for (int v = 0; v < V; v++) {
+      acc[v][s] = _mm512_dpbf16_ps(acc[v][s], x[v], y);
+    }
+  }
+}
+
+/* V panels of 16 rows and C columns of c starting at row panel and column
+ * j, one vector per panel and column; the rows past the end of c are masked
+ * out of the loads and stores. */
+template <int V, int C>
+__attribute__((target("avx512f,avx512bw,avx512bf16"))) void
+bf16Block(Eigen::MatrixXf &c, const uint32_t *packed, const Bf16Cols &b,
+          Eigen::Index panel, Eigen::Index j, bool accumulate) {
+  const Eigen::Index k = b.rows();
+  const Eigen::Index pairs = (k + 1) / 2;
+  __m512 acc[V][C];
+  for (int v = 0; v < V; v++) {
+    for (int s = 0; s < C; s++) {
+      acc[v][s] = _mm512_setzero_ps();
+    }
+  }
+  const Eigen::bfloat16 *columns[C];
+  for (int s = 0; s < C; s++) {
+    columns[s] = b.col(j + s).data();
+  }
+  for (Eigen::Index q = 0; q < k / 2; q++) {
+    bf16Step<V, C, false>(acc, packed, pairs, panel, q, columns);
+  }
+  if (k % 2 != 0) {
+    bf16Step<V, C, true>(acc, packed, pairs, panel, k / 2, columns);
+  }
+  for (int v = 0; v < V; v++) {
+    const Eigen::Index i = (panel + v) * 16;
+    const __mmask16 mask = c.rows() - i >= 16
+                               ? ~__mmask16(0)
+                               : (__mmask16(1) << (c.rows() - i)) - 1;
+    for (int s = 0; s < C; s++) {
+      float *out = c.col(j + s).data() + i;
+      if (accumulate) {
+        acc[v][s] = _mm512_add_ps(acc[v][s], _mm512_maskz_loadu_ps(mask, out));
+      }
+      _mm512_mask_storeu_ps(out, mask, acc[v][s]);
+    }
+  }
+}
+
+/* C columns of c starting at j, 2 panels of rows at a time. */
+template <int C>
+void bf16Columns(Eigen::MatrixXf &c, const uint32_t *packed,
+                 const Bf16Cols &b, Eigen::Index j, bool accumulate) {
+  const Eigen::Index panels = (c.rows() + 15) / 16;
+  Eigen::Index panel = 0;
+  for (; panel + 2 <= panels; panel += 2) {
+    bf16Block<2, C>(c, packed, b, panel, j, accumulate);
+  }
+  for (; panel < panels; panel++) {
+    bf16Block<1, C>(c, packed, b, panel, j, accumulate);
+  }
+}
+
+/* 16 values per step, rounded to nearest even; the last size % 16 values
+ * are loaded and stored masked. */
+__attribute__((target("avx512f,avx512bw,avx512vl,avx512bf16"))) void
+castBf16Avx512(Eigen::bfloat16 *dst, const float *src, Eigen::Index size) {
+  Eigen::Index i = 0;
+  for (; i + 16 <= size; i += 16) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                        (__m256i)_mm512_cvtneps_pbh(_mm512_loadu_ps(src + i)));
+  }
+  if (i < size) {
+    const __mmask16 mask = (__mmask16(1) << (size - i)) - 1;
+    _mm256_mask_storeu_epi16(
+        dst + i, mask,
+        (__m256i)_mm512_cvtneps_pbh(_mm512_maskz_loadu_ps(mask, src + i)));
+  }
+}
+#endif
+
+#ifdef PICOPEBBLE_USE_BLAS
+void blasGemm(Eigen::MatrixXf &c, const Eigen::MatrixXf &a, bool transpose_a,
+              const Eigen::MatrixXf &b, bool transpose_b, bool accumulate) {
+  const Eigen::Index m = transpose_a ? a.cols() : a.rows();
+  const Eigen::Index n = transpose_b ? b.rows() : b.cols();
+  const Eigen::Index k = transpose_a ? a.rows() : a.cols();
+  if (!accumulate) {
+    c.resize(m, n);
+  }
+  // Eigen is column-major, so are the leading dimensions
+  cblas_sgemm(CblasColMajor, transpose_a ? CblasTrans : CblasNoTrans,
+              transpose_b ? CblasTrans : CblasNoTrans, m, n, k, 1.f,
+              a.data(), a.rows(), b.data(), b.rows(), accumulate ? 1.f : 0.f,
+              c.data(), c.rows());
+}
+
+typedef std::tuple<Eigen::Index, Eigen::Index, Eigen::Index, bool, bool>
+    GemmShape;
+
+struct GemmTable {
+  std::mutex mutex;
+  std::map<GemmShape, GemmBackend> backends;
+  // shapes being benchmarked
+  std::set<GemmShape> pending;
+  std::string cache_path;
+  bool write_cache = false;
+  // "host blas threads" that the cached lines of this process start with
+  std::string cache_key;
+};
+
+GemmTable &gemmTable() {
+  static GemmTable table;
+  return table;
+}
+
+/* Best time of reps runs, after one warm-up run. */
+template <typename F> double bestSeconds(Eigen::Index reps, const F &f) {
+  f();
+  double best = 1e30;
+  for (Eigen::Index i = 0; i < reps; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+/* What a cached choice depends on: host, BLAS build and thread count. */
+std::string cacheKey() {
+  char host[256] = {0};
+  if (gethostname(host, sizeof(host) - 1) != 0 || host[0] == '\0') {
+    std::snprintf(host, sizeof(host), "unknown");
+  }
+#ifdef PICOPEBBLE_OPENBLAS_THREADS
+  // version, target and threading of the library actually loaded
+  std::string blas = openblas_get_config();
+#else
+  std::string blas = PICOPEBBLE_BLAS_NAME;
+#endif
+  // one word each
+  std::replace_if(
+      blas.begin(), blas.end(), [](char c) { return std::isspace(c); }, '_');
+  std::ostringstream key;
+  key << host << ' ' << blas << ' ' << globalIntraOpThreads();
+  return key.str();
+}
+
+/* Time both backends on random operands of the given shape. */
+GemmBackend benchmarkShape(Eigen::Index m, Eigen::Index n, Eigen::Index k,
+                           bool transpose_a, bool transpose_b) {
+  Eigen::MatrixXf a = transpose_a ? Eigen::MatrixXf::Random(k, m)
+                                  : Eigen::MatrixXf::Random(m, k);
+  Eigen::MatrixXf b = transpose_b ? Eigen::MatrixXf::Random(n, k)
+                                  : Eigen::MatrixXf::Random(k, n);
+  Eigen::MatrixXf c(m, n);
+  // about 2^24 multiply-adds per backend, at least a few runs
+  const Eigen::Index work = m * n * k;
+  const Eigen::Index reps =
+      std::min<Eigen::Index>(100, std::max<Eigen::Index>(3, (1 << 24) / work));
+  double eigen_seconds = bestSeconds(reps, [&]() {
+    eigenGemm(c, a, transpose_a, b, transpose_b, false);
+  });
+  double blas_seconds = bestSeconds(reps, [&]() {
+    blasGemm(c, a, transpose_a, b, transpose_b, false);
+  });
+  return blas_seconds < eigen_seconds ? BLAS_GEMM : EIGEN_GEMM;
+}
+#endif
+} // namespace
+
+GemmBackend DeepLearningFramework::gemmBackend(Eigen::Index m, Eigen::Index n,
+                                               Eigen::Index k,
+                                               bool transpose_a,
+                                               bool transpose_b) {
+#ifdef PICOPEBBLE_USE_BLAS
+  // BLAS rejects empty leading dimensions
+  if (m == 0 || n == 0 || k == 0) {
+    return EIGEN_GEMM;
+  }
+  GemmTable &table = gemmTable();
+  GemmShape shape(m, n, k, transpose_a, transpose_b);
+  {
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto it = table.backends.find(shape);
+    if (it != table.backends.end()) {
+      return it->second;
+    }
+    // another thread is timing this shape, do not wait for it
+    if (!table.pending.insert(shape).second) {
+      return EIGEN_GEMM;
+    }
+  }
+
+  GemmBackend backend = benchmarkShape(m, n, k, transpose_a, transpose_b);
+  std::lock_guard<std::mutex> lock(table.mutex);
+  table.pending.erase(shape);
+  table.backends[shape] = backend;
+  if (table.write_cache && !table.cache_path.empty()) {
+    std::ofstream cache(table.cache_path, std::ios::app);
+    cache << table.cache_key << ' ' << m << ' ' << n << ' ' << k << ' '
+          << transpose_a << ' ' << transpose_b << ' '
+          << (backend == BLAS_GEMM ? "blas" : "eigen") << '\n';
+  }
+  return backend;
+#else
+  return EIGEN_GEMM;
+#endif
+}
+
+void DeepLearningFramework::gemm(Eigen::MatrixXf &c, const Eigen::MatrixXf &a,
+                                 bool transpose_a, const Eigen::MatrixXf &b,
+                                 bool transpose_b, bool accumulate) {
+#ifdef PICOPEBBLE_USE_BLAS
+  const Eigen::Index m = transpose_a ? a.cols() : a.rows();
+  const Eigen::Index n = transpose_b ? b.rows() : b.cols();
+  const Eigen::Index k = transpose_a ? a.rows() : a.cols();
+  if (gemmBackend(m, n, k, transpose_a, transpose_b) == BLAS_GEMM) {
+    blasGemm(c, a, transpose_a, b, transpose_b, accumulate);
+    return;
+  }
+#endif
+  eigenGemm(c, a, transpose_a, b, transpose_b, accumulate);
+}
+
+bool DeepLearningFramework::int8IsaSupported(Int8Isa isa) {
+  switch (isa) {
+#ifdef PICOPEBBLE_X86
+  case INT8_AVX_VNNI:
+    return __builtin_cpu_supports("avxvnni");
+  case INT8_AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  case INT8_EIGEN:
+    return true;
+  default:
+    return false;
+  }
+}
+
+Int8Isa &DeepLearningFramework::int8Isa() {
+  static Int8Isa isa = int8IsaSupported(INT8_AVX_VNNI) ? INT8_AVX_VNNI
+                       : int8IsaSupported(INT8_AVX2)   ? INT8_AVX2
+                                                       : INT8_EIGEN;
+  return isa;
+}
+
+void DeepLearningFramework::gemmInt8(Eigen::MatrixXi &c,
+                                     const RowMajorMatrixXi8 &a,
+                                     const MatrixXi8 &b) {
+  const Int8Isa isa = int8Isa();
+  if (isa == INT8_EIGEN) {
+    // Eigen's GEMM on widened operands beats a plain loop
+    c.noalias() = a.cast<int32_t>() * b.cast<int32_t>();
+    return;
+  }
+#ifdef PICOPEBBLE_X86
+  const Eigen::Index k = a.cols();
+  c.resize(a.rows(), b.cols());
+
+  // column sums of b over the part the VNNI kernel vectorizes
+  std::vector<int32_t> b_sums;
+  if (isa == INT8_AVX_VNNI) {
+    b_sums.resize(b.cols());
+    for (Eigen::Index j = 0; j < b.cols(); j++) {
+      b_sums[j] = b.col(j).head(k / 32 * 32).cast<int32_t>().sum();
+    }
+  }
+
+  // pairs of rows share the loads of b
+  parallelFor((a.rows() + 1) / 2, 2 * b.cols() * k,
+              [&](Eigen::Index begin, Eigen::Index end) {
+                for (Eigen::Index pair = begin; pair < end; pair++) {
+                  const Eigen::Index i = 2 * pair;
+                  if (i + 1 < a.rows()) {
+                    int8Rows<2>(isa, c, a, b, b_sums.data(), i);
+                  } else {
+                    int8Rows<1>(isa, c, a, b, b_sums.data(), i);
+                  }
+                }
+              });
+#endif
+}
+
+void DeepLearningFramework::gemmBf16(Eigen::MatrixXf &c, const Bf16Rows &a,
+                                     const Bf16Cols &b, bool accumulate) {
+  if (!accumulate) {
+    c.resize(a.rows(), b.cols());
+  }
+#ifdef PICOPEBBLE_X86
+  if (hasBf16Dot()) {
+    // reused across calls, so that steady state does not allocate
+    static thread_local std::vector<uint32_t> packed;
+    packBf16Rows(packed, a);
+    // the workers see their own thread_local, so pass the caller's data
+    const uint32_t *rows = packed.data();
+    // blocks of 8 columns share the loads of the packed rows
+    parallelFor((b.cols() + 7) / 8, 8 * a.rows() * a.cols(),
+                [&](Eigen::Index begin, Eigen::Index end) {
+                  for (Eigen::Index block = begin; block < end; block++) {
+                    const Eigen::Index j = 8 * block;
+                    if (j + 8 <= b.cols()) {
+                      bf16Columns<8>(c, rows, b, j, accumulate);
+                    } else {
+                      for (Eigen::Index s = j; s < b.cols(); s++) {
+                        bf16Columns<1>(c, rows, b, s, accumulate);
+                      }
+                    }
+                  }
+                });
+    return;
+  }
+#endif
+  if (accumulate) {
+    c.noalias() += a.cast<float>() * b.cast<float>();
+  } else {
+    c.noalias() = a.cast<float>() * b.cast<float>();
+  }
+}
+
+void DeepLearningFramework::castBf16(
+    Eigen::Matrix<Eigen::bfloat16, Eigen::Dynamic, Eigen::Dynamic> &dst,
+    const Eigen::MatrixXf &src) {
+#ifdef PICOPEBBLE_X86
+  if (hasBf16Dot()) {
+    dst.resize(src.rows(), src.cols());
+    castBf16Avx512(dst.data(), src.data(), src.size());
+    return;
+  }
+#endif
+  dst = src.cast<Eigen::bfloat16>();
+}
+
+void DeepLearningFramework::initGemmBackends(const std::string &cache_path,
+                                             bool write_cache) {
+#ifdef PICOPEBBLE_USE_BLAS
+#ifdef PICOPEBBLE_OPENBLAS_THREADS
+  // same budget as Eigen, so that ranks sharing a host do not oversubscribe
+  openblas_set_num_threads(globalIntraOpThreads());
+#endif
+  GemmTable &table = gemmTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  table.cache_path = cache_path;
+  table.write_cache = write_cache;
+  table.cache_key = cacheKey();
+  if (cache_path.empty()) {
+    return;
+  }
+  // keep only the choices made on this host, BLAS and thread count
+  std::ifstream cache(cache_path);
+  const std::string prefix = table.cache_key + ' ';
+  std::string line;
+  while (std::getline(cache, line)) {
+    if (line.compare(0, prefix.size(), prefix) != 0) {
+      continue;
+    }
+    std::istringstream fields(line.substr(prefix.size()));
+    Eigen::Index m, n, k;
+    bool transpose_a, transpose_b;
+    std::string backend;
+    if (fields >> m >> n >> k >> transpose_a >> transpose_b >> backend) {
+      table.backends[GemmShape(m, n, k, transpose_a, transpose_b)] =
+          backend == "blas" ? BLAS_GEMM : EIGEN_GEMM;
+    }
+  }
+#else
+  static_cast<void>(cache_path);
+  static_cast<void>(write_cache);
+#endif
+}
@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Counter-based random numbers implementation
+ */
+
+#include "Random.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+
+using namespace DeepLearningFramework;
+
+namespace {
+// Counter {block, index, step} and key {seed, kind}: every element of every
+// sequence gets its own Philox input.
+void streamKey(const RandomStream &stream, uint32_t key[2]) {
+  const uint64_t seed = globalSeed();
+  key[0] = static_cast<uint32_t>(seed);
+  key[1] = static_cast<uint32_t>(seed >> 32) + stream.kind * 0x9E3779B9u;
+}
+
+inline void streamBlock(const RandomStream &stream, const uint32_t key[2],
+                        uint64_t block, uint32_t out[4]) {
+  const uint32_t counter[4] = {static_cast<uint32_t>(block),
+                               static_cast<uint32_t>(block >> 32),
+                               stream.index, stream.step};
+  philox4x32(counter, key, out);
+}
+
+// 24 random bits to [0, 1)
+inline float toUnit(uint32_t bits) {
+  return static_cast<float>(bits >> 8) * (1.f / 16777216.f);
+}
+} // namespace
+
+void DeepLearningFramework::randomBits(const RandomStream &stream,
+                                       uint64_t block, uint64_t blocks,
+                                       uint32_t *out) {
+  uint32_t key[2];
+  streamKey(stream, key);
+  parallelFor(blocks, 40, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index b = begin; b < end; ++b) {
+      streamBlock(stream, key, block + b, out + 4 * b);
+    }
+  });
+}
+
+void DeepLearningFramework::randomUniform(float *values, Eigen::Index count,
+                                          uint64_t offset,
+                                          const RandomStream &stream,
+                                          float low, float high) {
+  if (count <= 0) {
+    return;
+  }
+  uint32_t key[2];
+  streamKey(stream, key);
+  const float scale = high - low;
+  const uint64_t first_block = offset / 4;
+  const uint64_t last_block = (offset + count - 1) / 4;
+  parallelFor(last_block - first_block + 1, 40,
+              [&](Eigen::Index begin, Eigen::Index end) {
+                for (Eigen::Index b = begin; b < end; ++b) {
+                  const uint64_t block = first_block + b;
+                  uint32_t bits[4];
+                  streamBlock(stream, key, block, bits);
+                  // the first and last blocks may be partly outside
+                  for (int lane = 0; lane < 4; ++lane) {
+                    const uint64_t element = 4 * block + lane;
+                    if (element >= offset && element < offset + count) {
+                      values[element - offset] =
+                          low + scale * toUnit(bits[lane]);
+                    }
+                  }
+                }
+              });
+}
+
+Eigen::MatrixXf DeepLearningFramework::randomMatrix(Eigen::Index rows,
+                                                    Eigen::Index cols,
+                                                    const RandomStream &stream,
+                                                    float low, float high) {
+  Eigen::MatrixXf matrix(rows, cols);
+  randomUniform(matrix.data(), matrix.size(), 0, stream, low, high);
+  return matrix;
+}
+
+void DeepLearningFramework::randomPermutation(
+    std::vector<int64_t> &permutation, int64_t n, const RandomStream &stream) {
+  permutation.resize(n);
+  for (int64_t i = 0; i < n; ++i) {
+    permutation[i] = i;
+  }
+  if (n < 2) {
+    return;
+  }
+  // one random word per swap, drawn up front in parallel
+  std::vector<uint32_t> bits(4 * ((n + 3) / 4));
+  randomBits(stream, 0, bits.size() / 4, bits.data());
+  for (int64_t i = n - 1; i > 0; --i) {
+    // 64-bit multiply-shift maps the word to [0, i] without division
+    const int64_t j = static_cast<int64_t>(
+        (static_cast<uint64_t>(bits[i]) * static_cast<uint64_t>(i + 1)) >> 32);
+    std::swap(permutation[i], permutation[j]);
+  }
+}
@@ -22,13 +22,421 @@
 #include "DataLoader.hpp"
 #include "Common.hpp"
 #include "GlobalState.hpp"
+#include "Random.hpp"
 #include "mpi/MpiController.hpp"
+#include <Eigen/SparseCore>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <dirent.h>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace DeepLearningFramework;
 
+namespace {
+const char *kDatasetDirs[] = {"train_features/", "train_labels/",
+                              "test_features/", "test_labels/"};
+
+// Read-only mapping of a whole file.
+struct FileMapping {
+  void *data;
+  size_t size;
+  // whether the file could be read; an empty one maps no data
+  bool opened;
+};
+
+FileMapping mapFile(const std::string &filename) {
+  FileMapping mapping = {nullptr, 0, false};
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return mapping;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == 0) {
+    mapping.opened = file_stat.st_size == 0;
+    if (file_stat.st_size > 0) {
+      void *data =
+          mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (data != MAP_FAILED) {
+        mapping.data = data;
+        mapping.size = file_stat.st_size;
+        mapping.opened = true;
+        madvise(data, mapping.size, MADV_SEQUENTIAL);
+      }
+    }
+  }
+  close(fd);
+  return mapping;
+}
+
+void unmapFiles(std::vector<FileMapping> &mappings) {
+  for (FileMapping &mapping : mappings) {
+    if (mapping.data != nullptr) {
+      munmap(mapping.data, mapping.size);
+    }
+  }
+  mappings.clear();
+}
+
+// Header of a mapped binary part, nullptr if it is not a valid one.
+const DatasetPartHeader *partHeader(const FileMapping &mapping) {
+  if (mapping.size < kDatasetPartAlignment) {
+    return nullptr;
+  }
+  const DatasetPartHeader *header =
+      static_cast<const DatasetPartHeader *>(mapping.data);
+  if (std::memcmp(header->magic, kDatasetPartMagic,
+                  sizeof(kDatasetPartMagic)) != 0 ||
+      header->version != kDatasetPartVersion ||
+      header->dtype != DATASET_FLOAT32 ||
+      mapping.size < kDatasetPartAlignment +
+                         header->rows * header->cols * sizeof(float)) {
+    return nullptr;
+  }
+  return header;
+}
+
+inline bool isSeparator(char c) {
+  return c == ',' || c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool endsToken(const char *p, const char *end) {
+  return p == end || *p == '\n' || isSeparator(*p);
+}
+
+// Whether a double in the range of normal floats is within a few units in
+// its last place of halfway between two floats, where the 29 bits below the
+// float mantissa are 1000...0.
+inline bool nearFloatMidpoint(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const int64_t low = static_cast<int64_t>(bits & 0x1fffffffULL);
+  return std::abs(low - 0x10000000LL) <= 8;
+}
+
+// Decimal float token at p, which is advanced past the token. No locale, no
+// allocation: up to 19 significant digits are gathered in an integer and
+// scaled by an exact power of ten in double, which is within a few units in
+// its last place of the value. Unless that is as close to halfway between
+// two floats, both round to the same float; those and the values beyond
+// the powers of ten are parsed by strtof, so that every value is the float
+// strtof gives. Returns false, with value 0, if the token is not a number.
+bool parseFloat(const char *&p, const char *end, float &value) {
+  static const double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                  1e18, 1e19, 1e20, 1e21, 1e22};
+  const char *token = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool number = false;
+  for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+    number = true;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    } else {
+      ++exponent;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+      number = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+        --exponent;
+      }
+    }
+  }
+  if (number && p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool negative_exponent = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative_exponent = *p == '-';
+      ++p;
+    }
+    int digits_value = 0;
+    number = p < end && *p >= '0' && *p <= '9';
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+      digits_value = std::min(digits_value * 10 + (*p - '0'), 1000);
+    }
+    exponent += negative_exponent ? -digits_value : digits_value;
+  }
+  if (!number || !endsToken(p, end)) {
+    while (!endsToken(p, end)) {
+      ++p;
+    }
+    value = 0.f;
+    return false;
+  }
+
+  if (exponent >= -22 && exponent <= 22) {
+    double scaled = static_cast<double>(mantissa);
+    scaled = exponent < 0 ? scaled / powers[-exponent]
+                          : scaled * powers[exponent];
+    if (scaled == 0.0 || (scaled >= std::numeric_limits<float>::min() &&
+                          scaled <= std::numeric_limits<float>::max() &&
+                          !nearFloatMidpoint(scaled))) {
+      value = static_cast<float>(negative ? -scaled : scaled);
+      return true;
+    }
+  }
+  // rare: extreme values, subnormals and values close to halfway
+  const size_t length = p - token;
+  char buffer[64];
+  if (length < sizeof(buffer)) {
+    std::memcpy(buffer, token, length);
+    buffer[length] = '\0';
+    value = std::strtof(buffer, nullptr);
+  } else {
+    value = std::strtof(std::string(token, p).c_str(), nullptr);
+  }
+  return true;
+}
+
+// Number of lines holding a value in a CSV buffer.
+Eigen::Index countRows(const char *begin, const char *end) {
+  Eigen::Index rows = 0;
+  while (begin < end) {
+    const char *newline =
+        static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+    const char *line_end = newline != nullptr ? newline : end;
+    const char *p = begin;
+    while (p < line_end && isSeparator(*p)) {
+      ++p;
+    }
+    rows += p < line_end;
+    begin = line_end + 1;
+  }
+  return rows;
+}
+
+// Number of values on the first line of a CSV buffer that holds any.
+Eigen::Index countColumns(const char *begin, const char *end) {
+  Eigen::Index cols = 0;
+  for (const char *p = begin; p < end && cols == 0; ++p) {
+    while (p < end && *p != '\n') {
+      if (isSeparator(*p)) {
+        ++p;
+        continue;
+      }
+      while (!endsToken(p, end)) {
+        ++p;
+      }
+      cols++;
+    }
+  }
+  return cols;
+}
+
+// Parse up to max_rows non-empty lines of a CSV buffer into consecutive rows
+// of a column-major block with leading dimension ld, advancing p past them.
+// Missing values are 0, and so are tokens that are not numbers, which also
+// clear valid. Returns the number of rows parsed.
+Eigen::Index parseRows(const char *&p, const char *end, float *block,
+                       Eigen::Index ld, Eigen::Index cols,
+                       Eigen::Index max_rows, bool &valid) {
+  Eigen::Index row = 0;
+  while (p < end && row < max_rows) {
+    Eigen::Index col = 0;
+    bool empty = true;
+    while (p < end && *p != '\n') {
+      if (isSeparator(*p)) {
+        ++p;
+        continue;
+      }
+      empty = false;
+      float value;
+      valid = parseFloat(p, end, value) && valid;
+      if (col < cols) {
+        block[col * ld + row] = value;
+      }
+      col++;
+    }
+    ++p;
+    if (!empty) {
+      for (; col < cols; ++col) {
+        block[col * ld + row] = 0.f;
+      }
+      row++;
+    }
+  }
+  return row;
+}
+
+// Advance p past n non-empty lines of a CSV buffer.
+void skipRows(const char *&p, const char *end, Eigen::Index n) {
+  while (p < end && n > 0) {
+    const char *newline =
+        static_cast<const char *>(std::memchr(p, '\n', end - p));
+    const char *line_end = newline != nullptr ? newline : end;
+    while (p < line_end && isSeparator(*p)) {
+      ++p;
+    }
+    n -= p < line_end;
+    p = line_end + 1;
+  }
+}
+
+// Rows [begin, end) of the rows samples of a split this rank trains on: in
+// data parallelism an equal share for every rank, the remainder left out so
+// that all ranks step in lockstep, otherwise all of them.
+void shardRange(Eigen::Index rows, Eigen::Index &begin, Eigen::Index &end) {
+  begin = 0;
+  end = rows;
+  if (globalParallelismMode() == DATA_PARALLELISM) {
+    const Eigen::Index share = rows / globalController().mpiSize();
+    begin = share * globalController().mpiRank();
+    end = begin + share;
+  }
+}
+
+bool makeDirectory(const std::string &path) {
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+// Rows of a CSV or binary part file, read in order a few at a time, or one
+// at a time in any order once opened for random access.
+class PartReader {
+public:
+  PartReader()
+      : _mapping{nullptr, 0, false}, _header(nullptr), _cursor(nullptr),
+        _valid(true) {}
+  ~PartReader() { close(); }
+
+  bool open(const std::string &filename, bool random_access = false) {
+    close();
+    _mapping = mapFile(filename);
+    if (!_mapping.opened) {
+      return false;
+    }
+    _header = partHeader(_mapping);
+    _cursor = static_cast<const char *>(_mapping.data);
+    _row = 0;
+    _valid = true;
+    if (random_access) {
+      madvise(_mapping.data, _mapping.size, MADV_RANDOM);
+      // a CSV row is found through the start of its line
+      const char *end = _cursor + _mapping.size;
+      for (const char *p = _cursor; _header == nullptr && p < end;) {
+        const char *newline =
+            static_cast<const char *>(std::memchr(p, '\n', end - p));
+        const char *line_end = newline != nullptr ? newline : end;
+        const char *value = p;
+        while (value < line_end && isSeparator(*value)) {
+          ++value;
+        }
+        if (value < line_end) {
+          _lines.push_back(p);
+        }
+        p = line_end + 1;
+      }
+    }
+    return true;
+  }
+
+  bool isOpen() const { return _mapping.opened; }
+
+  // False once a CSV token read so far was not a number.
+  bool isValid() const { return _valid; }
+
+  void close() {
+    if (_mapping.data != nullptr) {
+      munmap(_mapping.data, _mapping.size);
+    }
+    _mapping = {nullptr, 0, false};
+    _header = nullptr;
+    _lines.clear();
+  }
+
+  // Rows in the part; a CSV part is scanned once for them.
+  Eigen::Index rows() const {
+    if (_header != nullptr) {
+      return _header->rows;
+    }
+    const char *data = static_cast<const char *>(_mapping.data);
+    return countRows(data, data + _mapping.size);
+  }
+
+  Eigen::Index cols() const {
+    if (_header != nullptr) {
+      return _header->cols;
+    }
+    const char *data = static_cast<const char *>(_mapping.data);
+    return countColumns(data, data + _mapping.size);
+  }
+
+  // Copy the next count rows into rows [row, row + count) of block.
+  Eigen::Index read(Eigen::MatrixXf &block, Eigen::Index row,
+                    Eigen::Index count) {
+    if (_header == nullptr) {
+      const char *end =
+          static_cast<const char *>(_mapping.data) + _mapping.size;
+      return parseRows(_cursor, end, block.data() + row, block.rows(),
+                       block.cols(), count, _valid);
+    }
+    const float *values = reinterpret_cast<const float *>(
+        static_cast<const char *>(_mapping.data) + kDatasetPartAlignment);
+    const Eigen::Index part_rows = _header->rows;
+    count = std::min(count, part_rows - _row);
+    block.middleRows(row, count) =
+        Eigen::Map<const Eigen::MatrixXf>(values, part_rows, block.cols())
+            .middleRows(_row, count);
+    _row += count;
+    return count;
+  }
+
+  void skip(Eigen::Index count) {
+    if (_header == nullptr) {
+      skipRows(_cursor,
+               static_cast<const char *>(_mapping.data) + _mapping.size, count);
+    } else {
+      _row += count;
+    }
+  }
+
+  // Copy row part_row into row row of block, random access only.
+  void readRow(Eigen::Index part_row, Eigen::MatrixXf &block,
+               Eigen::Index row) {
+    if (_header == nullptr) {
+      const char *p = _lines[part_row];
+      parseRows(p, static_cast<const char *>(_mapping.data) + _mapping.size,
+                block.data() + row, block.rows(), block.cols(), 1, _valid);
+      return;
+    }
+    const float *values = reinterpret_cast<const float *>(
+        static_cast<const char *>(_mapping.data) + kDatasetPartAlignment);
+    block.row(row) =
+        Eigen::Map<const Eigen::MatrixXf>(values, _header->rows, block.cols())
+            .row(part_row);
+  }
+
+private:
+  FileMapping _mapping;
+  const DatasetPartHeader *_header;
+  const char *_cursor;
+  Eigen::Index _row;
+  std::vector<const char *> _lines;
+  bool _valid;
+};
+} // namespace
+
 void DataLoader::load(const std::string &path, Eigen::MatrixXf &X_train,
                       Eigen::MatrixXf &y_train, Eigen::MatrixXf &X_test,
                       Eigen::MatrixXf &y_test) {
@@ -36,56 +444,321 @@ void DataLoader::load(const std::string &path, Eigen::MatrixXf &X_train,
   std::string y_train_path = path + "train_labels/";
   std::string X_test_path = path + "test_features/";
   std::string y_test_path = path + "test_labels/";
-  loadMatrix(X_train_path, X_train);
-  loadMatrix(y_train_path, y_train);
-  loadMatrix(X_test_path, X_test);
-  loadMatrix(y_test_path, y_test);
+  // in pipeline parallelism only the first stage takes features and only
+  // the last one labels
+  bool features = true, labels = true;
+  if (globalParallelismMode() == PIPELINE_MODEL_PARALLELISM) {
+    features = globalController().mpiRank() == 0;
+    labels = globalController().mpiRank() == globalController().mpiSize() - 1;
+  }
+  auto start = std::chrono::steady_clock::now();
+  size_t csv_bytes = loadMatrix(X_train_path, X_train, features);
+  csv_bytes += loadMatrix(y_train_path, y_train, labels);
+  csv_bytes += loadMatrix(X_test_path, X_test, features);
+  csv_bytes += loadMatrix(y_test_path, y_test, labels);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (csv_bytes > 0) {
+    const double megabytes = csv_bytes / 1e6;
+    Log() << "Parsed " << megabytes << " MB of CSV in "
+          << elapsed.count() * 1e3 << " ms, "
+          << megabytes / elapsed.count() << " MB/s";
+  }
+}
+
+void DataLoader::loadSparse(const std::string &path, Eigen::Index feature_dim,
+                            SparseBatch &X_train, Eigen::MatrixXf &y_train,
+                            SparseBatch &X_test, Eigen::MatrixXf &y_test) {
+  loadSparseMatrix(path + "train_features/", feature_dim, X_train);
+  loadMatrix(path + "train_labels/", y_train);
+  loadSparseMatrix(path + "test_features/", feature_dim, X_test);
+  loadMatrix(path + "test_labels/", y_test);
+}
+
+void DataLoader::loadSparseMatrix(const std::string &path, Eigen::Index cols,
+                                  SparseBatch &concat_matrix) {
+  std::vector<std::string> part_files = listFiles(path);
+
+  // every line is a sample, even an empty one
+  Eigen::Index total_rows = 0;
+  for (const std::string &part_file : part_files) {
+    FileMapping mapping = mapFile(part_file);
+    if (!mapping.opened) {
+      std::cerr << "Could not open the file: " << part_file << std::endl;
+      concat_matrix.resize(0, cols);
+      return;
+    }
+    if (mapping.data != nullptr) {
+      const char *data = static_cast<const char *>(mapping.data);
+      total_rows += std::count(data, data + mapping.size, '\n') +
+                    (data[mapping.size - 1] != '\n');
+      munmap(mapping.data, mapping.size);
+    }
+  }
+  Eigen::Index shard_begin, shard_end;
+  shardRange(total_rows, shard_begin, shard_end);
+
+  std::vector<Eigen::Triplet<float>> triplets;
+  Eigen::Index rows = 0;
+  for (int i = 0; i < part_files.size() && rows < shard_end; i++) {
+    std::ifstream file(part_files[i]);
+    if (!file.is_open()) {
+      std::cerr << "Could not open the file: " << part_files[i] << std::endl;
+      concat_matrix.resize(0, cols);
+      return;
+    }
+
+    std::string line;
+    while (rows < shard_end && std::getline(file, line)) {
+      if (rows++ < shard_begin) {
+        continue;
+      }
+      std::replace(line.begin(), line.end(), ',', ' ');
+      std::stringstream line_stream(line);
+      std::string entry;
+      while (line_stream >> entry) {
+        size_t colon = entry.find(':');
+        if (colon == std::string::npos) {
+          continue;
+        }
+        Eigen::Index col = std::stol(entry.substr(0, colon));
+        float value = std::stof(entry.substr(colon + 1));
+        if (col >= 0 && col < cols && value != 0.f) {
+          triplets.emplace_back(rows - 1 - shard_begin, col, value);
+        }
+      }
+    }
+  }
+
+  concat_matrix.resize(shard_end - shard_begin, cols);
+  concat_matrix.setFromTriplets(triplets.begin(), triplets.end());
 }
 
-void DataLoader::loadMatrix(const std::string &path,
-                            Eigen::MatrixXf &concat_matrix) {
+size_t DataLoader::loadMatrix(const std::string &path,
+                              Eigen::MatrixXf &concat_matrix, bool load) {
   std::vector<std::string> part_files = listFiles(path);
+  size_t bytes = 0;
+  if (load && !loadBinaryMatrix(part_files, concat_matrix, true)) {
+    bytes = loadCsvMatrix(part_files, concat_matrix, true);
+  }
+  // A rank only parses the parts of its shard, so a part that one rank
+  // could not read (the matrix has no column) empties it on all of them.
+  int local_loaded = !load || concat_matrix.cols() > 0, loaded = 0;
+  globalController().mpiAllreduce<int>(&local_loaded, &loaded, 1, MPI_MIN);
+  if (!loaded) {
+    concat_matrix.resize(0, 0);
+  }
+  if (globalParallelismMode() == PIPELINE_MODEL_PARALLELISM) {
+    // a stage that skips the matrix gets its rows without any column, so
+    // that every stage takes the same number of steps
+    int64_t local_rows = load ? concat_matrix.rows() : 0, rows = 0;
+    globalController().mpiAllreduce<int64_t>(&local_rows, &rows, 1, MPI_MAX);
+    if (!load) {
+      concat_matrix.resize(rows, 0);
+    }
+  }
+  return bytes;
+}
 
-  for (int i = 0; i < part_files.size(); i++) {
-    Eigen::MatrixXf matrix = readMatrixFromFile(part_files[i]);
-    if (concat_matrix.rows() == 0) {
-      concat_matrix.resize(matrix.rows() * part_files.size(), matrix.cols());
+size_t DataLoader::loadCsvMatrix(const std::vector<std::string> &part_files,
+                                 Eigen::MatrixXf &concat_matrix, bool shard) {
+  const int parts = part_files.size();
+  std::vector<FileMapping> mappings(parts);
+  std::vector<Eigen::Index> rows(parts + 1, 0);
+  // one mapping per part, parts scanned and parsed on the intra-op threads
+  parallelFor(parts, 1 << 20, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index i = begin; i < end; ++i) {
+      mappings[i] = mapFile(part_files[i]);
+      const char *data = static_cast<const char *>(mappings[i].data);
+      rows[i + 1] = countRows(data, data + mappings[i].size);
     }
-    concat_matrix.block(matrix.rows() * i, 0, matrix.rows(), matrix.cols()) =
-        matrix;
+  });
+
+  // a missing part would shift every following row, fail the whole load
+  for (int i = 0; i < parts; i++) {
+    if (!mappings[i].opened) {
+      std::cerr << "Could not open the file: " << part_files[i] << std::endl;
+      unmapFiles(mappings);
+      concat_matrix.resize(0, 0);
+      return 0;
+    }
+  }
+
+  size_t bytes = 0;
+  Eigen::Index cols = 0;
+  for (int i = 0; i < parts; i++) {
+    if (cols == 0) {
+      const char *data = static_cast<const char *>(mappings[i].data);
+      cols = countColumns(data, data + mappings[i].size);
+    }
+    bytes += mappings[i].size;
+    rows[i + 1] += rows[i];
   }
+
+  Eigen::Index shard_begin = 0, shard_end = rows[parts];
+  if (shard) {
+    shardRange(rows[parts], shard_begin, shard_end);
+  }
+
+  // each part writes its rows of the shard straight into the result
+  concat_matrix.resize(shard_end - shard_begin, cols);
+  float *values = concat_matrix.data();
+  const Eigen::Index ld = concat_matrix.rows();
+  std::vector<char> valid(parts, true);
+  parallelFor(parts, 1 << 20, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index i = begin; i < end; ++i) {
+      const Eigen::Index first = std::max(shard_begin, rows[i]);
+      const Eigen::Index last = std::min(shard_end, rows[i + 1]);
+      if (first < last) {
+        const char *data = static_cast<const char *>(mappings[i].data);
+        const char *data_end = data + mappings[i].size;
+        bool part_valid = true;
+        skipRows(data, data_end, first - rows[i]);
+        parseRows(data, data_end, values + first - shard_begin, ld, cols,
+                  last - first, part_valid);
+        valid[i] = part_valid;
+      }
+    }
+  });
+  unmapFiles(mappings);
+  for (int i = 0; i < parts; i++) {
+    if (!valid[i]) {
+      std::cerr << "Not a valid part file: " << part_files[i] << std::endl;
+      concat_matrix.resize(0, 0);
+      break;
+    }
+  }
+  return bytes;
 }
 
-Eigen::MatrixXf DataLoader::readMatrixFromFile(const std::string &filename) {
-  std::ifstream file(filename);
+bool DataLoader::loadBinaryMatrix(const std::vector<std::string> &part_files,
+                                  Eigen::MatrixXf &concat_matrix, bool shard) {
+  std::vector<FileMapping> mappings;
+  for (const std::string &part_file : part_files) {
+    mappings.push_back(mapFile(part_file));
+  }
+  if (mappings.empty() || partHeader(mappings[0]) == nullptr) {
+    unmapFiles(mappings);
+    return false;
+  }
+
+  // parts may differ in rows, not in columns (an empty part has none); any
+  // other part that is not a valid binary part fails the whole load
+  Eigen::Index cols = 0, rows = 0;
+  for (int i = 0; i < mappings.size(); i++) {
+    const DatasetPartHeader *header = partHeader(mappings[i]);
+    if (header != nullptr && header->rows > 0 && cols == 0) {
+      cols = header->cols;
+    }
+    if (header == nullptr || (header->rows > 0 && header->cols != cols)) {
+      std::cerr << "Not a valid part file: " << part_files[i] << std::endl;
+      unmapFiles(mappings);
+      concat_matrix.resize(0, 0);
+      return true;
+    }
+    rows += header->rows;
+  }
+
+  Eigen::Index shard_begin = 0, shard_end = rows;
+  if (shard) {
+    shardRange(rows, shard_begin, shard_end);
+  }
+
+  concat_matrix.resize(shard_end - shard_begin, cols);
+  Eigen::Index row = 0;
+  for (FileMapping &mapping : mappings) {
+    const Eigen::Index part_rows = partHeader(mapping)->rows;
+    const Eigen::Index first = std::max(shard_begin, row);
+    const Eigen::Index last = std::min(shard_end, row + part_rows);
+    if (first < last) {
+      const float *values = reinterpret_cast<const float *>(
+          static_cast<const char *>(mapping.data) + kDatasetPartAlignment);
+      concat_matrix.middleRows(first - shard_begin, last - first) =
+          Eigen::Map<const Eigen::MatrixXf>(values, part_rows, cols)
+              .middleRows(first - row, last - first);
+    }
+    row += part_rows;
+  }
+  unmapFiles(mappings);
+  return true;
+}
+
+bool DataLoader::writeBinaryPart(const std::string &filename,
+                                 const Eigen::MatrixXf &matrix) {
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
   if (!file.is_open()) {
     std::cerr << "Could not open the file: " << filename << std::endl;
-    return Eigen::MatrixXf();
+    return false;
   }
+  DatasetPartHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kDatasetPartMagic, sizeof(header.magic));
+  header.version = kDatasetPartVersion;
+  header.dtype = DATASET_FLOAT32;
+  header.rows = matrix.rows();
+  header.cols = matrix.cols();
+
+  const std::vector<char> padding(kDatasetPartAlignment - sizeof(header), 0);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(padding.data(), padding.size());
+  file.write(reinterpret_cast<const char *>(matrix.data()),
+             matrix.size() * sizeof(float));
+  return static_cast<bool>(file);
+}
 
-  std::string line;
-  std::vector<std::vector<float>> data;
-  while (std::getline(file, line)) {
-    std::vector<float> row;
-    std::stringstream line_stream(line);
-    float value;
-    while (line_stream >> value) {
-      row.push_back(value);
-      if (line_stream.peek() == ',') {
-        line_stream.ignore();
+bool DataLoader::convert(const std::string &path,
+                         const std::string &output_path) {
+  MPIController &global_controller = globalController();
+  const int mpi_rank = global_controller.mpiRank();
+  const int mpi_size = global_controller.mpiSize();
+
+  int converted = makeDirectory(output_path);
+  for (const char *dataset_dir : kDatasetDirs) {
+    const std::string input_dir = path + dataset_dir;
+    const std::string output_dir = output_path + dataset_dir;
+    converted = makeDirectory(output_dir) && converted;
+
+    // every part of the directory, not only the share listFiles gives
+    std::vector<std::string> names;
+    DIR *dir = opendir(input_dir.c_str());
+    if (dir == nullptr) {
+      std::cerr << "Could not open path: " << input_dir << std::endl;
+      converted = 0;
+      continue;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+      if (entry->d_type == DT_REG && entry->d_name[0] != '.') {
+        names.emplace_back(entry->d_name);
       }
     }
-    data.push_back(row);
-  }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
 
-  Eigen::MatrixXf matrix(data.size(), data[0].size());
-  for (size_t i = 0; i < data.size(); ++i) {
-    for (size_t j = 0; j < data[i].size(); ++j) {
-      matrix(i, j) = data[i][j];
+    for (size_t i = mpi_rank; i < names.size(); i += mpi_size) {
+      Eigen::MatrixXf matrix;
+      converted = readMatrixFromFile(input_dir + names[i], matrix) &&
+                  writeBinaryPart(output_dir + names[i], matrix) &&
+                  converted;
     }
   }
 
-  return matrix;
+  // done when every rank is
+  int all_converted = 0;
+  global_controller.mpiAllreduce<int>(&converted, &all_converted, 1, MPI_MIN);
+  return all_converted != 0;
+}
+
+bool DataLoader::readMatrixFromFile(const std::string &filename,
+                                    Eigen::MatrixXf &matrix) {
+  struct stat status;
+  if (stat(filename.c_str(), &status) != 0) {
+    std::cerr << "Could not open the file: " << filename << std::endl;
+    return false;
+  }
+  loadCsvMatrix({filename}, matrix);
+  // an empty part is read as a matrix without rows
+  return matrix.size() > 0 || status.st_size == 0;
 }
 
 std::vector<std::string> DataLoader::listFiles(const std::string &path) {
@@ -97,63 +770,311 @@ std::vector<std::string> DataLoader::listFiles(const std::string &path) {
 
   MPIController &global_controller = globalController();
   int mpi_rank = global_controller.mpiRank();
-  int mpi_size = global_controller.mpiSize();
 
   if (mpi_rank == 0) {
     dir = opendir(path.c_str());
     if (dir == nullptr) {
+      // no part at all, still broadcast so that the other ranks return
       std::cerr << "Could not open path: " << path << std::endl;
-      return local_files;
-    }
-
-    while ((entry = readdir(dir)) != nullptr) {
-      if (entry->d_type == DT_REG && entry->d_name[0] != '.') {
-        file_ranks.emplace_back(file_count);
-        file_count++;
+    } else {
+      while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_type == DT_REG && entry->d_name[0] != '.') {
+          file_ranks.emplace_back(file_count);
+          file_count++;
+        }
       }
+      closedir(dir);
     }
-    closedir(dir);
   }
 
-  if (globalParallelismMode() == DATA_PARALLELISM) {
-    int counts[mpi_size];
-    if (mpi_rank == 0) {
-      for (int i = 0; i < mpi_size; i++) {
-        counts[i] = file_count / mpi_size;
-      }
+  // every rank sees every part, ranks shard them by sample
+  global_controller.mpiBcast(file_count, 0);
 
-      int remainder = file_count % mpi_size;
+  if (mpi_rank != 0) {
+    file_ranks.resize(file_count);
+  }
+  global_controller.mpiBcast(file_ranks, file_count, 0);
+
+  for (auto &rank : file_ranks) {
+    local_files.emplace_back(path + "part-" + formatString(rank));
+  }
 
-      for (int i = 0; i < remainder; i++) {
-        counts[i]++;
+  return local_files;
+}
+
+BatchStream::BatchStream(const std::string &path, const std::string &split,
+                         Eigen::Index batch_size, bool drop_last,
+                         bool shuffle, int prefetch)
+    : _batch_size(batch_size), _shard_begin(0), _rows(0), _batch_count(0),
+      _classes(0), _one_hot(false), _read_features(true), _read_labels(true),
+      _shuffle(shuffle), _pass(0), _produced(0), _consumed(0), _done(true),
+      _stop(false) {
+  // in pipeline parallelism only the first stage reads features and only
+  // the last one labels, the batches of the others have no such columns
+  if (globalParallelismMode() == PIPELINE_MODEL_PARALLELISM) {
+    _read_features = globalController().mpiRank() == 0;
+    _read_labels =
+        globalController().mpiRank() == globalController().mpiSize() - 1;
+  }
+  _feature_files = DataLoader::listFiles(path + split + "_features/");
+  _label_files = DataLoader::listFiles(path + split + "_labels/");
+  if (_feature_files.size() != _label_files.size()) {
+    std::cerr << "Feature and label parts differ in number: " << path + split
+              << std::endl;
+    _feature_files.clear();
+    _label_files.clear();
+  }
+
+  // Parts are aligned row by row, so one that cannot be read or does not
+  // match the others leaves the whole split empty. Rank 0 reads the layout
+  // of the split for all ranks.
+  const int parts = _feature_files.size();
+  int64_t feature_cols = 0, label_cols = 0;
+  float max_label = -1.f;
+  _part_begin.assign(parts + 1, 0);
+  if (globalController().mpiRank() == 0) {
+    PartReader features, labels;
+    Eigen::MatrixXf label_values(1 << 12, 1);
+    for (int i = 0; i < parts; i++) {
+      if (!features.open(_feature_files[i]) ||
+          !labels.open(_label_files[i])) {
+        std::cerr << "Could not open the file: " << _feature_files[i]
+                  << std::endl;
+        _part_begin.assign(parts + 1, 0);
+        break;
+      }
+      const Eigen::Index rows = features.rows();
+      if (rows > 0 && feature_cols == 0) {
+        feature_cols = features.cols();
+        label_cols = labels.cols();
+      }
+      if (rows > 0 &&
+          (features.cols() != feature_cols || labels.cols() != label_cols)) {
+        std::cerr << "Not a valid part file: " << _feature_files[i]
+                  << std::endl;
+        _part_begin.assign(parts + 1, 0);
+        break;
       }
+      if (labels.rows() != rows) {
+        std::cerr << "Feature and label rows differ: " << _feature_files[i]
+                  << std::endl;
+        _part_begin.assign(parts + 1, 0);
+        break;
+      }
+      // class labels are read once for their count
+      for (Eigen::Index left = label_cols == 1 ? rows : 0; left > 0;) {
+        const Eigen::Index count = labels.read(
+            label_values, 0, std::min(left, label_values.rows()));
+        if (count == 0) {
+          break;
+        }
+        max_label =
+            std::max(max_label, label_values.topRows(count).maxCoeff());
+        left -= count;
+      }
+      _part_begin[i + 1] = _part_begin[i] + rows;
     }
+  }
+  globalController().mpiBcast(_part_begin, parts + 1, 0);
+  globalController().mpiBcast(feature_cols, 0);
+  globalController().mpiBcast(label_cols, 0);
+  globalController().mpiBcast(max_label, 0);
 
-    int local_count;
+  Eigen::Index shard_end;
+  shardRange(_part_begin.back(), _shard_begin, shard_end);
+  _rows = shard_end - _shard_begin;
+  _classes = label_cols == 1 ? static_cast<Eigen::Index>(max_label) + 1 : 0;
+  _batch_count = _rows / batch_size;
+  if (!drop_last && _rows % batch_size != 0) {
+    _batch_count++;
+  }
+  _ring.resize(prefetch + 1);
+  for (Batch &batch : _ring) {
+    batch.features.resize(batch_size, _read_features ? feature_cols : 0);
+    batch.labels.resize(batch_size, _read_labels ? label_cols : 0);
+  }
+}
 
-    global_controller.mpiScatter(counts, 1, local_count, 1, 0);
+BatchStream::~BatchStream() { stop(); }
 
-    std::vector<int64_t> local_file_ranks(local_count);
-    int ret = global_controller.mpiScatterv(file_ranks, counts, local_file_ranks,
-                                            local_count, 0);
+BatchStream::Iterator BatchStream::begin() {
+  stop();
+  if (_shuffle) {
+    randomPermutation(_order, _part_begin.back(),
+                      {SHUFFLE_RANDOM, 0, _pass++});
+  }
+  _produced = 0;
+  _consumed = 0;
+  _done = false;
+  _stop = false;
+  _producer = std::thread(&BatchStream::produce, this);
+  return Iterator(this, acquire(0) ? 0 : _batch_count);
+}
 
-    for (auto &rank : local_file_ranks) {
-      local_files.emplace_back(path + "part-" + formatString(rank));
+const BatchStream::Batch &BatchStream::Iterator::operator*() const {
+  return _stream->_ring[_index % _stream->_ring.size()];
+}
+
+BatchStream::Iterator &BatchStream::Iterator::operator++() {
+  _stream->release();
+  ++_index;
+  if (_index < _stream->_batch_count && !_stream->acquire(_index)) {
+    _index = _stream->_batch_count;
+  }
+  return *this;
+}
+
+void BatchStream::stop() {
+  if (!_producer.joinable()) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _cv.notify_all();
+  _producer.join();
+}
+
+bool BatchStream::acquire(Eigen::Index index) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _cv.wait(lock, [&]() { return _produced > index || _done; });
+  return _produced > index;
+}
+
+void BatchStream::release() {
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _consumed++;
+  }
+  _cv.notify_all();
+}
+
+void BatchStream::produce() {
+  const Eigen::Index slots = _ring.size();
+  const size_t parts = _part_begin.size() - 1;
+  const bool one_hot = _one_hot && _read_labels;
+  // in order: the open part and the next row of the split to read from it;
+  // shuffled: every part touched so far, opened for random access
+  std::vector<PartReader> features(_shuffle ? parts : 1);
+  std::vector<PartReader> labels(_shuffle ? parts : 1);
+  std::vector<bool> opened(features.size(), false);
+  // open the parts of part i this stage reads
+  auto open = [&](size_t reader, size_t i) {
+    opened[reader] = true;
+    return (!_read_features || features[reader].open(_feature_files[i],
+                                                     _shuffle)) &&
+           (!_read_labels || labels[reader].open(_label_files[i], _shuffle));
+  };
+  size_t part = 0;
+  Eigen::Index next = _shard_begin;
+  bool failed = false;
+  for (Eigen::Index index = 0; index < _batch_count && !failed; index++) {
+    {
+      // the slot is free once the batch that used it has been handed back
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock, [&]() { return _produced - _consumed < slots || _stop; });
+      if (_stop) {
+        break;
+      }
     }
-  } else {
-    global_controller.mpiBcast(file_count, 0);
 
-    if (mpi_rank != 0) {
-        file_ranks.resize(file_count);
+    Batch &batch = _ring[index % slots];
+    const Eigen::Index size =
+        std::min(_batch_size, _rows - index * _batch_size);
+    // only a smaller last batch changes the shape of a buffer
+    if (batch.features.rows() != size) {
+      batch.features.resize(size, batch.features.cols());
+      batch.labels.resize(size, batch.labels.cols());
+    }
+    if (one_hot && (batch.one_hot_labels.rows() != size ||
+                    batch.one_hot_labels.cols() != _classes)) {
+      batch.one_hot_labels.resize(size, _classes);
     }
-    global_controller.mpiBcast(file_ranks, file_count, 0);
-    std::vector<int64_t>& local_file_ranks = file_ranks;
 
-    for (auto &rank : local_file_ranks) {
-      local_files.emplace_back(path + "part-" + formatString(rank));
+    if (_shuffle) {
+      const int64_t *rows = _order.data() + _shard_begin + index * _batch_size;
+      for (Eigen::Index row = 0; row < size && !failed; row++) {
+        const size_t i = std::upper_bound(_part_begin.begin(),
+                                          _part_begin.end(), rows[row]) -
+                         _part_begin.begin() - 1;
+        if (!opened[i] && !open(i, i)) {
+          failed = true;
+          break;
+        }
+        if (_read_features) {
+          features[i].readRow(rows[row] - _part_begin[i], batch.features,
+                              row);
+        }
+        if (_read_labels) {
+          labels[i].readRow(rows[row] - _part_begin[i], batch.labels, row);
+        }
+        if (!features[i].isValid() || !labels[i].isValid()) {
+          std::cerr << "Not a valid part file: " << _feature_files[i]
+                    << std::endl;
+          failed = true;
+        }
+      }
+    } else {
+      Eigen::Index filled = 0;
+      while (filled < size) {
+        if (!opened[0] || next == _part_begin[part + 1]) {
+          // the part holding row next, empty parts passed over
+          while (_part_begin[part + 1] <= next) {
+            part++;
+          }
+          if (!open(0, part)) {
+            failed = true;
+            break;
+          }
+          if (_read_features) {
+            features[0].skip(next - _part_begin[part]);
+          }
+          if (_read_labels) {
+            labels[0].skip(next - _part_begin[part]);
+          }
+        }
+        const Eigen::Index count =
+            std::min(size - filled, _part_begin[part + 1] - next);
+        if (_read_features) {
+          features[0].read(batch.features, filled, count);
+        }
+        if (_read_labels) {
+          labels[0].read(batch.labels, filled, count);
+        }
+        if (!features[0].isValid() || !labels[0].isValid()) {
+          std::cerr << "Not a valid part file: " << _feature_files[part]
+                    << std::endl;
+          failed = true;
+          break;
+        }
+        filled += count;
+        next += count;
+      }
+    }
+    if (failed) {
+      break;
+    }
+    if (one_hot) {
+      batch.one_hot_labels.setZero();
+      for (Eigen::Index row = 0; row < size; row++) {
+        const Eigen::Index label = static_cast<Eigen::Index>(batch.labels(row));
+        if (label >= 0 && label < _classes) {
+          batch.one_hot_labels(row, label) = 1.f;
+        }
+      }
     }
-  }
 
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _produced++;
+    }
+    _cv.notify_all();
+  }
 
-  return local_files;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done = true;
+  }
+  _cv.notify_all();
 }
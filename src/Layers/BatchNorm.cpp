@@ -0,0 +1,185 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * BatchNorm1d layer class implementation
+ */
+
+#include "BatchNorm.hpp"
+#include "Parallel.hpp"
+
+#include <cmath>
+#include <iostream>
+
+using namespace DeepLearningFramework::Layers;
+
+BatchNorm1d::BatchNorm1d(int features, float eps, float momentum)
+    : _features(features), _eps(eps), _momentum(momentum) {
+  _gamma = Eigen::MatrixXf::Ones(1, features);
+  _beta = Eigen::MatrixXf::Zero(1, features);
+  _gamma_grad = Eigen::MatrixXf::Zero(1, features);
+  _beta_grad = Eigen::MatrixXf::Zero(1, features);
+  _running_mean = Eigen::ArrayXf::Zero(features);
+  _running_var = Eigen::ArrayXf::Ones(features);
+}
+
+void BatchNorm1d::allreduceStatistics() {
+  _reduced.resize(_stats.size());
+  runCollective([this]() {
+    globalController().mpiAllreduceSum<float>(_stats.data(), _reduced.data(),
+                                              _stats.size());
+  });
+  _stats.swap(_reduced);
+}
+
+void BatchNorm1d::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  const Eigen::Index batch = x.rows();
+  const Eigen::Index features = x.cols();
+
+  // one pass over each column: sum and sum of squares of each feature
+  _stats.resize(2 * features + 1);
+  parallelFor(features, 2 * batch, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index col = begin; col < end; ++col) {
+      auto values = x.col(col).array();
+      _stats[col] = values.sum();
+      _stats[features + col] = values.square().sum();
+    }
+  });
+  _stats[2 * features] = static_cast<float>(batch);
+  const bool sync = syncsStatistics() && exchangesGradients();
+  if (sync) {
+    allreduceStatistics();
+  }
+
+  // _stats becomes [mean, var]
+  const float n = _stats[2 * features];
+  Eigen::Map<Eigen::ArrayXf> mean(_stats.data(), features);
+  Eigen::Map<Eigen::ArrayXf> var(_stats.data() + features, features);
+  mean /= n;
+  var = (var / n - mean.square()).max(0.f);
+  _inv_std = (var + _eps).rsqrt();
+  const float unbiased = n > 1.f ? n / (n - 1.f) : 1.f;
+  _running_mean = (1.f - _momentum) * _running_mean + _momentum * mean;
+  _running_var =
+      (1.f - _momentum) * _running_var + _momentum * unbiased * var;
+
+  _xhat.resize(batch, features);
+  // no-op when out aliases x, whose columns are read before being written
+  out.resize(batch, features);
+  parallelFor(features, batch, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index col = begin; col < end; ++col) {
+      _xhat.col(col) = (x.col(col).array() - mean(col)) * _inv_std(col);
+      out.col(col).array() =
+          _xhat.col(col).array() * _gamma(0, col) + _beta(0, col);
+    }
+  });
+}
+
+void BatchNorm1d::predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  const Eigen::Index batch = x.rows();
+  const Eigen::Index features = x.cols();
+  out.resize(batch, features);
+  parallelFor(features, batch, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index col = begin; col < end; ++col) {
+      const float scale =
+          _gamma(0, col) / std::sqrt(_running_var(col) + _eps);
+      out.col(col).array() =
+          (x.col(col).array() - _running_mean(col)) * scale + _beta(0, col);
+    }
+  });
+}
+
+void BatchNorm1d::backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) {
+  const Eigen::Index batch = dout.rows();
+  const Eigen::Index features = dout.cols();
+
+  // one pass over each column: the sums of dout * xhat and of dout, which
+  // are the gradients of gamma and beta
+  _stats.resize(2 * features + 1);
+  parallelFor(features, 3 * batch, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index col = begin; col < end; ++col) {
+      auto dy = dout.col(col).array();
+      _stats[col] = (dy * _xhat.col(col).array()).sum();
+      _stats[features + col] = dy.sum();
+    }
+  });
+  _stats[2 * features] = static_cast<float>(batch);
+  const bool sync = syncsStatistics() && exchangesGradients();
+  if (sync) {
+    allreduceStatistics();
+  }
+
+  // din may alias dout, each column of which is read before being written
+  const float n = _stats[2 * features];
+  din.resize(batch, features);
+  parallelFor(features, 3 * batch, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index col = begin; col < end; ++col) {
+      const float gamma_grad = _stats[col] / n;
+      const float beta_grad = _stats[features + col] / n;
+      din.col(col).array() =
+          _gamma(0, col) * _inv_std(col) *
+          (dout.col(col).array() - beta_grad -
+           _xhat.col(col).array() * gamma_grad);
+    }
+  });
+
+  // gamma and beta gradients, averaged over the ranks
+  if (exchangesGradients()) {
+    if (!sync) {
+      allreduceStatistics();
+    }
+    Eigen::Map<Eigen::ArrayXf>(_stats.data(), 2 * features) /=
+        globalController().mpiSize();
+  }
+  Eigen::Map<const Eigen::MatrixXf> gamma_grad(_stats.data(), 1, features);
+  Eigen::Map<const Eigen::MatrixXf> beta_grad(_stats.data() + features, 1,
+                                              features);
+  if (_accumulate) {
+    _gamma_grad += gamma_grad;
+    _beta_grad += beta_grad;
+  } else {
+    _gamma_grad = gamma_grad;
+    _beta_grad = beta_grad;
+  }
+}
+
+bool BatchNorm1d::exchangesGradients() {
+  return globalParallelismMode() == DATA_PARALLELISM &&
+         globalController().mpiSize() > 1;
+}
+
+void BatchNorm1d::printDescription() {
+  std::cout << _name << " Layer [" << _features
+            << "], parameters: " << this->getParametersCount()
+            << ", eps: " << _eps << ", momentum: " << _momentum << std::endl;
+}
+
+void BatchNorm1d::collectParameters(std::vector<Parameter> &parameters) {
+  const bool exchanged = exchangesGradients();
+  parameters.push_back({_gamma.data(), _gamma_grad.data(), _gamma.size(),
+                        false, nullptr, exchanged});
+  parameters.push_back({_beta.data(), _beta_grad.data(), _beta.size(), false,
+                        nullptr, exchanged});
+}
+
+size_t BatchNorm1d::getSavedActivationBytes() {
+  return (_xhat.size() + _inv_std.size()) * sizeof(float);
+}
@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Dropout layer class implementation
+ */
+
+#include "Dropout.hpp"
+#include "GlobalState.hpp"
+#include "Parallel.hpp"
+#include "Random.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace DeepLearningFramework::Layers;
+
+uint32_t Dropout::_layer_count = 0;
+
+Dropout::Dropout(float p) : _p(p), _index(_layer_count++) {}
+
+void Dropout::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  const Eigen::Index size = x.size();
+  _mask.resize((size + 63) / 64);
+  out.resize(x.rows(), x.cols());
+
+  // one stream per layer and rank, one step per forward pass
+  const RandomStream stream = {
+      DROPOUT_RANDOM,
+      _index * globalController().mpiSize() + globalController().mpiRank(),
+      _step++};
+
+  // keep an element when its word is at least p * 2^32
+  const uint64_t threshold = static_cast<uint64_t>(
+      static_cast<double>(_p) * 4294967296.0);
+  const float scale = _p < 1.f ? 1.f / (1.f - _p) : 0.f;
+  const float *in = x.data();
+  float *result = out.data();
+  uint64_t *mask = _mask.data();
+  // the random words of each mask word are drawn in place, the 16 Philox
+  // blocks of elements [64 * word, 64 * word + 64)
+  parallelFor(_mask.size(), 704, [&](Eigen::Index begin, Eigen::Index end) {
+    uint32_t bits[64];
+    for (Eigen::Index word = begin; word < end; ++word) {
+      const Eigen::Index first = word * 64;
+      const Eigen::Index count = std::min<Eigen::Index>(64, size - first);
+      randomBits(stream, word * 16, (count + 3) / 4, bits);
+      uint64_t kept = 0;
+      for (Eigen::Index j = 0; j < count; ++j) {
+        const bool keep = bits[j] >= threshold;
+        kept |= static_cast<uint64_t>(keep) << j;
+        result[first + j] = keep ? in[first + j] * scale : 0.f;
+      }
+      mask[word] = kept;
+    }
+  });
+}
+
+void Dropout::backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) {
+  const Eigen::Index size = dout.size();
+  din.resize(dout.rows(), dout.cols());
+
+  const float scale = _p < 1.f ? 1.f / (1.f - _p) : 0.f;
+  const uint64_t *mask = _mask.data();
+  const float *grad = dout.data();
+  float *result = din.data();
+  parallelFor(_mask.size(), 64, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index word = begin; word < end; ++word) {
+      const Eigen::Index first = word * 64;
+      const Eigen::Index count = std::min<Eigen::Index>(64, size - first);
+      const uint64_t kept = mask[word];
+      for (Eigen::Index j = 0; j < count; ++j) {
+        result[first + j] = ((kept >> j) & 1u) ? grad[first + j] * scale : 0.f;
+      }
+    }
+  });
+}
+
+void Dropout::predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  if (&out != &x) {
+    out = x;
+  }
+}
+
+void Dropout::printDescription() {
+  std::cout << "Dropout Layer, p: " << _p << std::endl;
+}
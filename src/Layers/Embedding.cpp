@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Embedding layer class implementation
+ */
+
+#include "Embedding.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace DeepLearningFramework::Layers;
+
+namespace {
+// per-rank value counts from per-rank row counts
+std::vector<int> scaleCounts(const std::vector<int> &counts, int width) {
+  std::vector<int> scaled(counts);
+  for (int &count : scaled) {
+    count *= width;
+  }
+  return scaled;
+}
+} // namespace
+
+Embedding::Embedding(int64_t num_embeddings, int embedding_dim)
+    : _num_embeddings(num_embeddings), _dim(embedding_dim) {
+  _shards = globalParallelismMode() == DATA_PARALLELISM
+                ? globalController().mpiSize()
+                : 1;
+  _table = globalState().addEmbeddingTable(_num_embeddings, _dim, _shards);
+  _table_grad.width = _dim;
+}
+
+void Embedding::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  lookup(out, toIds(x), x.rows(), x.cols());
+}
+
+void Embedding::predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  lookup(out, toIds(x), x.rows(), x.cols());
+}
+
+void Embedding::forwardIds(Eigen::MatrixXf &out, const IdBatch &x) {
+  lookup(out, x.data(), x.rows(), x.cols());
+}
+
+void Embedding::predictIds(Eigen::MatrixXf &out, const IdBatch &x) {
+  lookup(out, x.data(), x.rows(), x.cols());
+}
+
+const int64_t *Embedding::toIds(const Eigen::MatrixXf &x) {
+  // floats hold every integer up to 2^24 only, past it ids would silently
+  // map to a neighbouring row
+  const float max_exact = 1 << 24;
+  _input_ids.resize(x.size());
+  for (Eigen::Index i = 0; i < x.size(); i++) {
+    const float id = x.data()[i];
+    if (id >= max_exact) {
+      std::cerr << "Embedding id " << id
+                << " is not exact as a float, pass ids as an IdBatch"
+                << std::endl;
+      exit(1);
+    }
+    _input_ids[i] = static_cast<int64_t>(id);
+  }
+  return _input_ids.data();
+}
+
+void Embedding::lookup(Eigen::MatrixXf &out, const int64_t *ids,
+                       Eigen::Index batch, Eigen::Index fields) {
+  const int shards = _shards;
+  const Eigen::Index count = batch * fields;
+
+  // distinct ids, grouped by owner
+  auto before = [shards](int64_t a, int64_t b) {
+    return a % shards != b % shards ? a % shards < b % shards : a < b;
+  };
+  _ids.assign(ids, ids + count);
+  for (int64_t id : _ids) {
+    if (id < 0 || id >= _num_embeddings) {
+      std::cerr << "Embedding id out of range: " << id << std::endl;
+      exit(1);
+    }
+  }
+  std::sort(_ids.begin(), _ids.end(), before);
+  _ids.erase(std::unique(_ids.begin(), _ids.end()), _ids.end());
+
+  _positions.resize(count);
+  for (Eigen::Index i = 0; i < count; i++) {
+    _positions[i] =
+        std::lower_bound(_ids.begin(), _ids.end(), ids[i], before) -
+        _ids.begin();
+  }
+
+  _send_counts.assign(shards, 0);
+  for (int64_t id : _ids) {
+    _send_counts[id % shards]++;
+  }
+
+  // ask the owners for their rows
+  if (shards == 1) {
+    _recv_counts = _send_counts;
+    _recv_ids = _ids;
+  } else {
+    runCollective([this]() {
+      globalController().mpiAlltoall(_send_counts, _recv_counts);
+      globalController().mpiAlltoallv(_ids, _send_counts, _recv_ids,
+                                      _recv_counts);
+    });
+  }
+
+  const Eigen::MatrixXf &shard = globalState().getEmbeddingShard(_table);
+  std::vector<float> rows(_recv_ids.size() * _dim);
+  for (size_t k = 0; k < _recv_ids.size(); k++) {
+    std::copy_n(shard.col(_recv_ids[k] / shards).data(), _dim,
+                &rows[k * _dim]);
+  }
+
+  // and receive the vectors along the same route
+  if (shards == 1) {
+    _vectors.swap(rows);
+  } else {
+    runCollective([this, &rows]() {
+      globalController().mpiAlltoallv(rows, scaleCounts(_recv_counts, _dim),
+                                      _vectors,
+                                      scaleCounts(_send_counts, _dim));
+    });
+  }
+
+  out.resize(batch, fields * _dim);
+  parallelFor(batch * fields, _dim, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index i = begin; i < end; i++) {
+      const float *vector = &_vectors[_positions[i] * _dim];
+      for (int d = 0; d < _dim; d++) {
+        out(i % batch, (i / batch) * _dim + d) = vector[d];
+      }
+    }
+  });
+}
+
+void Embedding::backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) {
+  const int shards = _shards;
+  const Eigen::Index batch = dout.rows();
+
+  // sum the gradients of each distinct id
+  std::vector<float> grads(_ids.size() * _dim, 0.f);
+  for (Eigen::Index i = 0; i < static_cast<Eigen::Index>(_positions.size());
+       i++) {
+    float *grad = &grads[_positions[i] * _dim];
+    for (int d = 0; d < _dim; d++) {
+      grad[d] += dout(i % batch, (i / batch) * _dim + d);
+    }
+  }
+
+  // send them back to the owners along the route of the lookup
+  std::vector<float> received;
+  if (shards == 1) {
+    received.swap(grads);
+  } else {
+    runCollective([this, &grads, &received]() {
+      globalController().mpiAlltoallv(grads, scaleCounts(_send_counts, _dim),
+                                      received,
+                                      scaleCounts(_recv_counts, _dim));
+    });
+  }
+
+  // local rows receiving a gradient, those not accumulated yet start from 0
+  std::vector<int64_t> rows(_recv_ids.size());
+  for (size_t k = 0; k < _recv_ids.size(); k++) {
+    rows[k] = _recv_ids[k] / shards;
+  }
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+  _table_grad.addRows(rows, _accumulate);
+
+  // averaged over ranks like the other data parallel gradients
+  const float scale = 1.f / shards;
+  for (size_t k = 0; k < _recv_ids.size(); k++) {
+    Eigen::Map<Eigen::VectorXf>(_table_grad.row(_recv_ids[k] / shards),
+                                _dim) +=
+        scale * Eigen::Map<const Eigen::VectorXf>(&received[k * _dim], _dim);
+  }
+  din.resize(0, 0);
+}
+
+void Embedding::printDescription() {
+  std::cout << "Embedding Layer [" << _num_embeddings << ", " << _dim
+            << "], parameters: " << this->getParametersCount()
+            << ", shards: " << _shards << std::endl;
+}
+
+void Embedding::collectParameters(std::vector<Parameter> &parameters) {
+  Eigen::MatrixXf &shard = globalState().getEmbeddingShard(_table);
+  parameters.push_back({shard.data(), nullptr, shard.size(), false,
+                        &_table_grad, true});
+}
+
+int64_t Embedding::getParametersCount() {
+  return _num_embeddings * _dim;
+}
+
+std::string Embedding::getName() { return _name; }
+
+size_t Embedding::getSavedActivationBytes() {
+  return _ids.size() * sizeof(int64_t) + _positions.size() * sizeof(int) +
+         _recv_ids.size() * sizeof(int64_t) + _vectors.size() * sizeof(float);
+}
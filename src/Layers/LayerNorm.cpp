@@ -0,0 +1,173 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * LayerNorm layer class implementation
+ */
+
+#include "LayerNorm.hpp"
+#include "Parallel.hpp"
+
+#include <iostream>
+
+using namespace DeepLearningFramework::Layers;
+
+LayerNorm::LayerNorm(int features, float eps)
+    : _features(features), _eps(eps) {
+  _gamma = Eigen::MatrixXf::Ones(1, features);
+  _beta = Eigen::MatrixXf::Zero(1, features);
+  _gamma_grad = Eigen::MatrixXf::Zero(1, features);
+  _beta_grad = Eigen::MatrixXf::Zero(1, features);
+}
+
+void LayerNorm::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  normalize(out, x, &_xhat, _inv_std);
+}
+
+void LayerNorm::predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  Eigen::ArrayXf inv_std;
+  normalize(out, x, nullptr, inv_std);
+}
+
+void LayerNorm::normalize(Eigen::MatrixXf &out, const Eigen::MatrixXf &x,
+                          Eigen::MatrixXf *xhat, Eigen::ArrayXf &inv_std) {
+  const Eigen::Index batch = x.rows();
+  const Eigen::Index features = x.cols();
+  _sum.resize(batch);
+  _sum_sq.resize(batch);
+
+  // one pass over x: sum and sum of squares of each sample, walking the
+  // columns of a block of samples per thread
+  parallelFor(batch, 2 * features, [&](Eigen::Index begin, Eigen::Index end) {
+    const Eigen::Index n = end - begin;
+    _sum.segment(begin, n).setZero();
+    _sum_sq.segment(begin, n).setZero();
+    for (Eigen::Index col = 0; col < features; ++col) {
+      auto values = x.col(col).segment(begin, n).array();
+      _sum.segment(begin, n) += values;
+      _sum_sq.segment(begin, n) += values.square();
+    }
+  });
+  // _sum becomes the mean
+  _sum /= static_cast<float>(features);
+  inv_std = ((_sum_sq / static_cast<float>(features) - _sum.square())
+                 .max(0.f) +
+             _eps)
+                .rsqrt();
+
+  if (xhat != nullptr) {
+    xhat->resize(batch, features);
+  }
+  // no-op when out aliases x, whose columns are read before being written
+  out.resize(batch, features);
+  parallelFor(features, batch, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index col = begin; col < end; ++col) {
+      auto normalized = (x.col(col).array() - _sum) * inv_std;
+      if (xhat != nullptr) {
+        xhat->col(col) = normalized;
+      }
+      out.col(col).array() = normalized * _gamma(0, col) + _beta(0, col);
+    }
+  });
+}
+
+void LayerNorm::backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) {
+  const Eigen::Index batch = dout.rows();
+  const Eigen::Index features = dout.cols();
+  _sum.resize(batch);
+  _sum_sq.resize(batch);
+
+  // one pass over dout: sums of dxhat and dxhat * xhat of each sample, with
+  // dxhat = dout * gamma
+  parallelFor(batch, 3 * features, [&](Eigen::Index begin, Eigen::Index end) {
+    const Eigen::Index n = end - begin;
+    _sum.segment(begin, n).setZero();
+    _sum_sq.segment(begin, n).setZero();
+    for (Eigen::Index col = 0; col < features; ++col) {
+      auto dxhat = dout.col(col).segment(begin, n).array() * _gamma(0, col);
+      _sum.segment(begin, n) += dxhat;
+      _sum_sq.segment(begin, n) +=
+          dxhat * _xhat.col(col).segment(begin, n).array();
+    }
+  });
+
+  // gradients of gamma and beta and of the input, column by column; din may
+  // alias dout, each column of which is read before being written
+  _local_grads.resize(2 * features);
+  din.resize(batch, features);
+  const float n = static_cast<float>(features);
+  parallelFor(features, 4 * batch, [&](Eigen::Index begin, Eigen::Index end) {
+    for (Eigen::Index col = begin; col < end; ++col) {
+      auto dy = dout.col(col).array();
+      auto xhat = _xhat.col(col).array();
+      _local_grads[col] = (dy * xhat).sum();
+      _local_grads[features + col] = dy.sum();
+      din.col(col).array() =
+          _inv_std / n * (n * _gamma(0, col) * dy - _sum - xhat * _sum_sq);
+    }
+  });
+
+  if (exchangesGradients()) {
+    _global_grads.resize(_local_grads.size());
+    runCollective([this]() {
+      globalController().mpiAllreduceSum<float>(
+          _local_grads.data(), _global_grads.data(), _local_grads.size());
+    });
+    _local_grads.swap(_global_grads);
+    Eigen::Map<Eigen::ArrayXf>(_local_grads.data(), _local_grads.size()) /=
+        globalController().mpiSize();
+  }
+
+  Eigen::Map<const Eigen::MatrixXf> gamma_grad(_local_grads.data(), 1,
+                                               features);
+  Eigen::Map<const Eigen::MatrixXf> beta_grad(_local_grads.data() + features,
+                                              1, features);
+  if (_accumulate) {
+    _gamma_grad += gamma_grad;
+    _beta_grad += beta_grad;
+  } else {
+    _gamma_grad = gamma_grad;
+    _beta_grad = beta_grad;
+  }
+}
+
+bool LayerNorm::exchangesGradients() {
+  return globalParallelismMode() == DATA_PARALLELISM &&
+         globalController().mpiSize() > 1;
+}
+
+void LayerNorm::printDescription() {
+  std::cout << "LayerNorm Layer [" << _features
+            << "], parameters: " << this->getParametersCount()
+            << ", eps: " << _eps << std::endl;
+}
+
+void LayerNorm::collectParameters(std::vector<Parameter> &parameters) {
+  const bool exchanged = exchangesGradients();
+  parameters.push_back({_gamma.data(), _gamma_grad.data(), _gamma.size(),
+                        false, nullptr, exchanged});
+  parameters.push_back({_beta.data(), _beta_grad.data(), _beta.size(), false,
+                        nullptr, exchanged});
+}
+
+size_t LayerNorm::getSavedActivationBytes() {
+  return (_xhat.size() + _inv_std.size()) * sizeof(float);
+}
@@ -25,7 +25,9 @@
 
 #include "Linear.hpp"
 #include "Eigen/src/Core/util/IndexedViewHelper.h"
+#include "Gemm.hpp"
 #include "GlobalState.hpp"
+#include "Parallel.hpp"
 #include <algorithm>
 
 #include <iostream>
@@ -33,7 +35,10 @@
 using namespace DeepLearningFramework::Layers;
 
 int Linear::_layer_count = 0;
-Linear::Linear(int input_size, int output_size) {
+Linear::Linear(int input_size, int output_size)
+    : Linear(input_size, output_size, true) {}
+
+Linear::Linear(int input_size, int output_size, bool dense_weights_grad) {
   _input_size = input_size;
   _output_size = output_size;
   _layer_rank = _layer_count++;
@@ -56,9 +61,26 @@ Linear::Linear(int input_size, int output_size) {
   case TENSOR_MODEL_PARALLELISM: {
   }
   }
+
+  if (_weights != nullptr) {
+    if (dense_weights_grad) {
+      _weights_grad =
+          Eigen::MatrixXf::Zero(_weights->rows(), _weights->cols());
+    }
+    _bias_grad = Eigen::MatrixXf::Zero(_bias->rows(), _bias->cols());
+  }
+}
+
+bool Linear::bf16Gemms() const {
+  return globalPrecisionMode() == MIXED_BF16 &&
+         globalParallelismMode() == DATA_PARALLELISM;
 }
 
 void Linear::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  if (bf16Gemms()) {
+    forwardBf16(out, x);
+    return;
+  }
   switch (globalParallelismMode()) {
   case DATA_PARALLELISM: {
     _forward_input = x;
@@ -74,53 +96,160 @@ void Linear::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
   case TENSOR_MODEL_PARALLELISM: {
   }
   }
-  out = x.matrix() * _weights->matrix();
-  for (int row = 0; row < out.rows(); ++row) {
-    out.row(row).array() -= _bias->array();
+  if (&out == &x) {
+    out = x.matrix() * _weights->matrix();
+  } else {
+    // write the product straight into out, reusing its storage
+    gemm(out, x, false, *_weights, false);
   }
+  addBias(out);
+}
+
+void Linear::predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  if (!_quantized) {
+    if (&out == &x) {
+      out = x.matrix() * _weights->matrix();
+    } else {
+      gemm(out, x, false, *_weights, false);
+    }
+    addBias(out);
+    return;
+  }
+
+  // int8 x int8 -> int32, then rescale by input_scale * weight_scale[col]
+  RowMajorMatrixXi8 x_int8 = (x.array() / _input_scale)
+                                 .round()
+                                 .max(-127.f)
+                                 .min(127.f)
+                                 .cast<int8_t>();
+  Eigen::MatrixXi acc;
+  gemmInt8(acc, x_int8, _weights_int8);
+  out = (acc.cast<float>().array().rowwise() *
+         (_input_scale * _weight_scales.array()))
+            .matrix();
+  addBias(out);
+}
+
+void Linear::quantize(const Eigen::MatrixXf &x) {
+  float input_max = x.size() > 0 ? x.cwiseAbs().maxCoeff() : 0.f;
+  _input_scale = input_max > 0.f ? input_max / 127.f : 1.f;
+
+  _weight_scales = _weights->cwiseAbs().colwise().maxCoeff() / 127.f;
+  _weight_scales = (_weight_scales.array() > 0.f).select(_weight_scales, 1.f);
+  _weights_int8 = (_weights->array().rowwise() / _weight_scales.array())
+                      .round()
+                      .max(-127.f)
+                      .min(127.f)
+                      .cast<int8_t>();
+  _quantized = true;
+}
+
+void Linear::dequantize() {
+  _quantized = false;
+  _weights_int8.resize(0, 0);
+}
+
+void Linear::addBias(Eigen::MatrixXf &out) {
+  parallelFor(out.cols(), out.rows(),
+              [&](Eigen::Index begin, Eigen::Index end) {
+                for (Eigen::Index col = begin; col < end; ++col) {
+                  out.col(col).array() += (*_bias)(0, col);
+                }
+              });
+}
+
+void Linear::forwardBf16(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  if (_weights_bf16_stale.exchange(false)) {
+    castBf16(_weights_bf16, *_weights);
+    _weights_transpose_bf16 = _weights_bf16.transpose();
+  }
+  // saved column-major for the weight gradient, row-major for this product
+  castBf16(_forward_input_bf16, x);
+  _input_rows_bf16 = _forward_input_bf16;
+  gemmBf16(out, _input_rows_bf16, _weights_bf16);
+  addBias(out);
 }
 
 void Linear::backward(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) {
+  if (bf16Gemms()) {
+    backwardBf16(din, dout);
+    return;
+  }
+  const Eigen::MatrixXf *forward_input = &_forward_input;
+  Eigen::MatrixXf tmp_forward_input;
   switch (globalParallelismMode()) {
   case DATA_PARALLELISM: {
-    (*_weights) -= _lr * (_forward_input.transpose() * dout);
     break;
   }
   // Re-Materializaition
   case PIPELINE_MODEL_PARALLELISM: {
-    Eigen::MatrixXf tmp_forward_input = firstLayerInput();
+    tmp_forward_input = firstLayerInput();
 
     for (int i = 0; i < _layer_rank - minLayerRank(); i++) {
       globalModel()[2 * i]->forward(tmp_forward_input, tmp_forward_input);
       // activation function
       globalModel()[2 * i + 1]->forward(tmp_forward_input, tmp_forward_input);
     }
-    (*_weights) -= _lr * (tmp_forward_input.transpose() * dout);
+    forward_input = &tmp_forward_input;
     break;
   }
   case TENSOR_MODEL_PARALLELISM: {
-    (*_weights) -= _lr * (_forward_input.transpose() * dout);
-    break;
   }
   }
-  // update weights and bias
-  (*_bias) -= _lr * dout.colwise().mean();
+  // gradients of weights and bias, applied later by the optimizer
+  gemm(_weights_grad, *forward_input, true, dout, false, _accumulate);
+  if (_accumulate) {
+    _bias_grad += dout.colwise().sum();
+  } else {
+    _bias_grad = dout.colwise().sum();
+  }
 
   // Calculate the gradient component for each input, which corresponds to the
   // output of the previous layer.
-  din = dout * _weights->transpose();
+  if (&din == &dout) {
+    din = dout * _weights->transpose();
+  } else {
+    gemm(din, dout, false, *_weights, true);
+  }
+}
+
+void Linear::backwardBf16(Eigen::MatrixXf &din, const Eigen::MatrixXf &dout) {
+  castBf16(_dout_bf16, dout);
+  _dout_rows_bf16 = _dout_bf16;
+  // input^T * dout, the rows of input^T being the columns of the saved input
+  Eigen::Map<const RowMajorMatrixXbf16> input_transpose(
+      _forward_input_bf16.data(), _forward_input_bf16.cols(),
+      _forward_input_bf16.rows());
+  gemmBf16(_weights_grad, input_transpose, _dout_bf16, _accumulate);
+  if (_accumulate) {
+    _bias_grad += dout.colwise().sum();
+  } else {
+    _bias_grad = dout.colwise().sum();
+  }
+  // dout * weights^T, din may be dout
+  gemmBf16(din, _dout_rows_bf16, _weights_transpose_bf16);
 }
 
 void Linear::printDescription() {
   std::cout << "Linear Layer [" << _input_size << ", " << _output_size << "], "
             << "parameters: " << this->getParametersCount()
-            << ", learning rate: " << _lr << std::endl;
+            << ", precision: "
+            << (globalPrecisionMode() == MIXED_BF16 ? "bf16/fp32" : "fp32")
+            << std::endl;
 }
 
-void Linear::setLR(float lr) { _lr = lr; }
+void Linear::collectParameters(std::vector<Parameter> &parameters) {
+  if (_weights == nullptr) {
+    return;
+  }
+  parameters.push_back({_weights->data(), _weights_grad.data(),
+                        _weights->size(), true, nullptr, false});
+  parameters.push_back({_bias->data(), _bias_grad.data(), _bias->size(),
+                        false, nullptr, false});
+}
 
-uint32_t Linear::getParametersCount() {
-  return _input_size * _output_size + _output_size;
+int64_t Linear::getParametersCount() {
+  return int64_t(_input_size) * _output_size + _output_size;
 }
 
 Eigen::MatrixXf Linear::getWeights() { return *_weights; }
@@ -131,6 +260,12 @@ void Linear::setWeightsAndBias(const Eigen::MatrixXf &weights,
                                const Eigen::MatrixXf &bias) {
   *_weights = weights;
   *_bias = bias;
+  _weights_bf16_stale = true;
 }
 
 std::string Linear::getName() { return _name; }
+
+size_t Linear::getSavedActivationBytes() {
+  return _forward_input.size() * sizeof(float) +
+         _forward_input_bf16.size() * sizeof(Eigen::bfloat16);
+}
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * SparseLinear layer class implementation
+ */
+
+#include "SparseLinear.hpp"
+#include "GlobalState.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+
+#include <iostream>
+
+using namespace DeepLearningFramework::Layers;
+
+SparseLinear::SparseLinear(int input_size, int output_size)
+    : Linear(input_size, output_size, false) {
+  _name = "SparseLinear";
+  if (_weights != nullptr) {
+    _weights->transposeInPlace();
+  }
+  _sparse_weights_grad.width = _output_size;
+}
+
+void SparseLinear::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  // Record the input of the first layer of the model allocated to this node.
+  if (globalParallelismMode() == PIPELINE_MODEL_PARALLELISM &&
+      _layer_rank == minLayerRank()) {
+    firstLayerInput() = x;
+  }
+  _sparse_input = x.sparseView();
+  apply(out, _sparse_input);
+}
+
+void SparseLinear::forwardSparse(Eigen::MatrixXf &out, const SparseBatch &x) {
+  _sparse_input = x;
+  apply(out, _sparse_input);
+}
+
+void SparseLinear::predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  SparseBatch sparse = x.sparseView();
+  apply(out, sparse);
+}
+
+void SparseLinear::predictSparse(Eigen::MatrixXf &out, const SparseBatch &x) {
+  apply(out, x);
+}
+
+void SparseLinear::apply(Eigen::MatrixXf &out, const SparseBatch &x) {
+  out.noalias() = x * _weights->transpose();
+  addBias(out);
+}
+
+void SparseLinear::backward(Eigen::MatrixXf &din,
+                            const Eigen::MatrixXf &dout) {
+  const SparseBatch &x = _sparse_input;
+  const Eigen::Index width = _output_size;
+
+  // features present in the batch, those without an accumulated gradient
+  // start from zero
+  _batch_rows.assign(x.innerIndexPtr(), x.innerIndexPtr() + x.nonZeros());
+  std::sort(_batch_rows.begin(), _batch_rows.end());
+  _batch_rows.erase(std::unique(_batch_rows.begin(), _batch_rows.end()),
+                    _batch_rows.end());
+  _sparse_weights_grad.addRows(_batch_rows, _accumulate);
+
+  float *grad = _sparse_weights_grad.values.data();
+  const std::vector<int64_t> &rows = _sparse_weights_grad.rows;
+  _grad_offsets.clear();
+  for (Eigen::Index sample = 0; sample < x.outerSize(); sample++) {
+    for (SparseBatch::InnerIterator it(x, sample); it; ++it) {
+      _grad_offsets.push_back(
+          (std::lower_bound(rows.begin(), rows.end(), it.col()) -
+           rows.begin()) *
+          width);
+    }
+  }
+
+  // weight rows += x(sample, row) * dout(sample, :), split over output columns
+  parallelFor(width, x.nonZeros(), [&](Eigen::Index begin, Eigen::Index end) {
+    const Eigen::Index *offset = _grad_offsets.data();
+    for (Eigen::Index sample = 0; sample < x.outerSize(); sample++) {
+      for (SparseBatch::InnerIterator it(x, sample); it; ++it) {
+        float *row = grad + *offset++;
+        for (Eigen::Index col = begin; col < end; col++) {
+          row[col] += it.value() * dout(sample, col);
+        }
+      }
+    }
+  });
+
+  if (_accumulate) {
+    _bias_grad += dout.colwise().sum();
+  } else {
+    _bias_grad = dout.colwise().sum();
+  }
+  din.resize(0, 0);
+}
+
+void SparseLinear::printDescription() {
+  std::cout << "SparseLinear Layer [" << _input_size << ", " << _output_size
+            << "], parameters: " << this->getParametersCount() << std::endl;
+}
+
+void SparseLinear::collectParameters(std::vector<Parameter> &parameters) {
+  if (_weights == nullptr) {
+    return;
+  }
+  parameters.push_back({_weights->data(), nullptr, _weights->size(), true,
+                        &_sparse_weights_grad, false});
+  parameters.push_back({_bias->data(), _bias_grad.data(), _bias->size(),
+                        false, nullptr, false});
+}
+
+size_t SparseLinear::getSavedActivationBytes() {
+  return _sparse_input.nonZeros() * (sizeof(float) + sizeof(int)) +
+         (_sparse_input.outerSize() + 1) * sizeof(int);
+}
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * CrossEntropy loss class implementation
+ */
+
+#include "CrossEntropy.hpp"
+
+#include <cmath>
+#include <iostream>
+
+using namespace DeepLearningFramework::Losses;
+
+CrossEntropy::CrossEntropy() {}
+
+void CrossEntropy::forward(float &loss, const Eigen::MatrixXf &y,
+                           const Eigen::MatrixXf &y_pred) {
+  // -log(softmax(z)_t) = logsumexp(z) - z_t, shifted by the row max.
+  _row_stat = y_pred.rowwise().maxCoeff();
+
+  loss = 0.f;
+  for (int i = 0; i < y_pred.rows(); ++i) {
+    float log_sum_exp =
+        std::log((y_pred.row(i).array() - _row_stat(i)).exp().sum());
+    loss += _row_stat(i) + log_sum_exp - y_pred(i, static_cast<int>(y(i)));
+  }
+  loss /= y_pred.rows();
+}
+
+void CrossEntropy::backward(Eigen::MatrixXf &dloss, const Eigen::MatrixXf &y,
+                            const Eigen::MatrixXf &y_pred) {
+  dloss.resize(y_pred.rows(), y_pred.cols());
+
+  // softmax computed in place in dloss
+  _row_stat = y_pred.rowwise().maxCoeff();
+  dloss.array() = (y_pred.array().colwise() - _row_stat.array()).exp();
+  _row_stat = dloss.rowwise().sum();
+  dloss.array().colwise() /= _row_stat.array();
+
+  for (int i = 0; i < dloss.rows(); ++i) {
+    dloss(i, static_cast<int>(y(i))) -= 1.f;
+  }
+  dloss /= static_cast<float>(y_pred.rows());
+}
+
+void CrossEntropy::printDescription() {
+  std::cout << "CrossEntropy loss (fused Softmax)" << std::endl;
+}
+
+std::string CrossEntropy::getName() { return _name; }
@@ -24,6 +24,7 @@
  */
 
 #include "MSE.hpp"
+#include "Parallel.hpp"
 
 #include <iostream>
 
@@ -33,12 +34,32 @@ MSE::MSE() {}
 
 void MSE::forward(float &loss, const Eigen::MatrixXf &y,
                   const Eigen::MatrixXf &y_pred) {
-  loss = (y_pred - y).squaredNorm() / y.rows();
+  const float *target = y.data();
+  const float *pred = y_pred.data();
+  double sum =
+      parallelSum(y.size(), 3, [&](Eigen::Index begin, Eigen::Index end) {
+        Eigen::Map<const Eigen::ArrayXf> target_chunk(target + begin,
+                                                      end - begin);
+        Eigen::Map<const Eigen::ArrayXf> pred_chunk(pred + begin, end - begin);
+        return static_cast<double>((pred_chunk - target_chunk).square().sum());
+      });
+  loss = static_cast<float>(sum / y.rows());
 }
 
 void MSE::backward(Eigen::MatrixXf &dloss, const Eigen::MatrixXf &y,
                    const Eigen::MatrixXf &y_pred) {
-  dloss = 2.f * (y_pred - y) / y.rows();
+  dloss.resize(y.rows(), y.cols());
+
+  const float scale = 2.f / y.rows();
+  const float *target = y.data();
+  const float *pred = y_pred.data();
+  float *result = dloss.data();
+  parallelFor(y.size(), 2, [&](Eigen::Index begin, Eigen::Index end) {
+    Eigen::Map<const Eigen::ArrayXf> target_chunk(target + begin, end - begin);
+    Eigen::Map<const Eigen::ArrayXf> pred_chunk(pred + begin, end - begin);
+    Eigen::Map<Eigen::ArrayXf> out_chunk(result + begin, end - begin);
+    out_chunk = scale * (pred_chunk - target_chunk);
+  });
 }
 
 void MSE::printDescription() { std::cout << "MSE loss" << std::endl; }
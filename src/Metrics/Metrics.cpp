@@ -31,6 +31,10 @@ using namespace DeepLearningFramework;
 void Metrics::accuracy(float &accuracy, const Eigen::MatrixXf &labels,
                        const Eigen::MatrixXf &features) {
   accuracy = 0.f;
+  // no labels, e.g. on a pipeline stage before the last
+  if (labels.size() == 0) {
+    return;
+  }
   for(int i = 0; i < labels.rows(); i++) {
     int y_pred = -1;
     features.row(i).maxCoeff(&y_pred);
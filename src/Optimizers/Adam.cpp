@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Adam optimizer class implementation
+ */
+
+#include "Adam.hpp"
+
+#include <cmath>
+#include <iostream>
+
+using namespace DeepLearningFramework::Optimizers;
+
+Adam::Adam(float lr, float beta1, float beta2, float eps)
+    : Optimizer(lr), _beta1(beta1), _beta2(beta2), _eps(eps) {}
+
+void Adam::beginStep() {
+  _correction1 = 1.f - std::pow(_beta1, static_cast<float>(_step));
+  _correction2 = 1.f - std::pow(_beta2, static_cast<float>(_step));
+}
+
+void Adam::update(float *value, const float *grad, Eigen::Index offset,
+                  Eigen::Index count, bool decay) {
+  Eigen::Map<Eigen::ArrayXf> v(value, count);
+  Eigen::Map<const Eigen::ArrayXf> g(grad, count);
+  auto m = _m.segment(offset, count);
+  auto s = _v.segment(offset, count);
+
+  m = _beta1 * m + (1.f - _beta1) * g;
+  s = _beta2 * s + (1.f - _beta2) * g.square();
+  v -= (_lr / _correction1) * m / ((s / _correction2).sqrt() + _eps);
+}
+
+void Adam::resetState(Eigen::Index total) {
+  _m = Eigen::ArrayXf::Zero(total);
+  _v = Eigen::ArrayXf::Zero(total);
+}
+
+void Adam::printDescription() {
+  std::cout << _name << " optimizer, learning rate: " << _lr
+            << ", beta1: " << _beta1 << ", beta2: " << _beta2
+            << ", eps: " << _eps << std::endl;
+}
+
+std::string Adam::getName() { return _name; }
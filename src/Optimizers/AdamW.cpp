@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * AdamW optimizer class implementation
+ */
+
+#include "AdamW.hpp"
+
+#include <iostream>
+
+using namespace DeepLearningFramework::Optimizers;
+
+AdamW::AdamW(float lr, float weight_decay, float beta1, float beta2,
+             float eps)
+    : Adam(lr, beta1, beta2, eps), _weight_decay(weight_decay) {
+  _name = "AdamW";
+}
+
+void AdamW::update(float *value, const float *grad, Eigen::Index offset,
+                   Eigen::Index count, bool decay) {
+  if (decay) {
+    Eigen::Map<Eigen::ArrayXf>(value, count) *= 1.f - _lr * _weight_decay;
+  }
+  Adam::update(value, grad, offset, count, decay);
+}
+
+void AdamW::printDescription() {
+  std::cout << _name << " optimizer, learning rate: " << _lr
+            << ", weight decay: " << _weight_decay << ", beta1: " << _beta1
+            << ", beta2: " << _beta2 << ", eps: " << _eps << std::endl;
+}
@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Optimizer class implementation
+ */
+
+#include "Optimizer.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+
+using namespace DeepLearningFramework;
+using namespace DeepLearningFramework::Optimizers;
+
+void Optimizer::setParameters(const std::vector<Parameter> &parameters) {
+  _parameters = parameters;
+  _offsets.assign(1, 0);
+  _dense.clear();
+  _dense_offsets.assign(1, 0);
+  _sparse.clear();
+  for (size_t i = 0; i < _parameters.size(); i++) {
+    const Parameter &parameter = _parameters[i];
+    _offsets.push_back(_offsets.back() + parameter.size);
+    if (parameter.sparse != nullptr) {
+      _sparse.push_back(i);
+    } else {
+      _dense.push_back(i);
+      _dense_offsets.push_back(_dense_offsets.back() + parameter.size);
+    }
+  }
+  _step = 0;
+  resetState(_offsets.back());
+}
+
+void Optimizer::step(float grad_scale) {
+  _step++;
+  beginStep();
+
+  parallelFor(_dense_offsets.back(), 8,
+              [&](Eigen::Index begin, Eigen::Index end) {
+                // first dense parameter overlapping [begin, end)
+                size_t k = std::upper_bound(_dense_offsets.begin(),
+                                            _dense_offsets.end(), begin) -
+                           _dense_offsets.begin() - 1;
+                for (; k < _dense.size() && _dense_offsets[k] < end; k++) {
+                  const Eigen::Index first = std::max(begin, _dense_offsets[k]);
+                  const Eigen::Index last =
+                      std::min(end, _dense_offsets[k + 1]);
+                  const Eigen::Index local = first - _dense_offsets[k];
+                  updateSlice(_dense[k], local,
+                              _parameters[_dense[k]].grad + local,
+                              last - first, grad_scale);
+                }
+              });
+
+  // row-sparse parameters: only the rows present in the gradient
+  for (size_t i : _sparse) {
+    SparseGradient &gradient = *_parameters[i].sparse;
+    const Eigen::Index width = gradient.width;
+    parallelFor(gradient.rows.size(), width * 8,
+                [&](Eigen::Index begin, Eigen::Index end) {
+                  for (Eigen::Index r = begin; r < end; r++) {
+                    updateSlice(i, gradient.rows[r] * width,
+                                &gradient.values[r * width], width,
+                                grad_scale);
+                  }
+                });
+  }
+}
+
+void Optimizer::updateSlice(size_t i, Eigen::Index local, float *grad,
+                            Eigen::Index count, float grad_scale) {
+  const Parameter &parameter = _parameters[i];
+  if (grad_scale != 1.f) {
+    Eigen::Map<Eigen::ArrayXf>(grad, count) *= grad_scale;
+  }
+  update(parameter.value + local, grad, _offsets[i] + local, count,
+         parameter.decay);
+}
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * SGD optimizer class implementation
+ */
+
+#include "SGD.hpp"
+
+#include <iostream>
+
+using namespace DeepLearningFramework::Optimizers;
+
+SGD::SGD(float lr, float momentum) : Optimizer(lr), _momentum(momentum) {}
+
+void SGD::update(float *value, const float *grad, Eigen::Index offset,
+                 Eigen::Index count, bool decay) {
+  Eigen::Map<Eigen::ArrayXf> v(value, count);
+  Eigen::Map<const Eigen::ArrayXf> g(grad, count);
+  if (_momentum == 0.f) {
+    v -= _lr * g;
+    return;
+  }
+  auto velocity = _velocity.segment(offset, count);
+  velocity = _momentum * velocity + g;
+  v -= _lr * velocity;
+}
+
+void SGD::resetState(Eigen::Index total) {
+  if (_momentum != 0.f) {
+    _velocity = Eigen::ArrayXf::Zero(total);
+  }
+}
+
+void SGD::printDescription() {
+  std::cout << "SGD optimizer, learning rate: " << _lr
+            << ", momentum: " << _momentum << std::endl;
+}
+
+std::string SGD::getName() { return _name; }
@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * MappedModel class implementation
+ */
+
+#include "MappedModel.hpp"
+#include "Identity.hpp"
+#include "ReLU.hpp"
+#include "Softmax.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace DeepLearningFramework;
+
+MappedModel::MappedModel(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Could not open the file: " << path << std::endl;
+    return;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    _size = file_stat.st_size;
+    _data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    if (_data == MAP_FAILED) {
+      _data = nullptr;
+    }
+  }
+  close(fd);
+
+  if (_data == nullptr || !parse(path)) {
+    std::cerr << "Not a valid model file: " << path << std::endl;
+    if (_data != nullptr) {
+      munmap(_data, _size);
+      _data = nullptr;
+    }
+    _layers.clear();
+  }
+}
+
+MappedModel::MappedModel(const char *image, size_t size) {
+  if (size > 0) {
+    _size = size;
+    _data = mmap(nullptr, _size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (_data == MAP_FAILED) {
+      _data = nullptr;
+    } else {
+      std::memcpy(_data, image, _size);
+      mprotect(_data, _size, PROT_READ);
+    }
+  }
+
+  if (_data == nullptr || !parse("<memory>")) {
+    std::cerr << "Not a valid model image" << std::endl;
+    if (_data != nullptr) {
+      munmap(_data, _size);
+      _data = nullptr;
+    }
+    _layers.clear();
+  }
+}
+
+MappedModel::~MappedModel() {
+  // the activations are destroyed with _layers, the weights with the mapping
+  _layers.clear();
+  if (_data != nullptr) {
+    munmap(_data, _size);
+  }
+}
+
+bool MappedModel::parse(const std::string &path) {
+  const char *base = static_cast<const char *>(_data);
+  if (_size < sizeof(ModelFileHeader)) {
+    return false;
+  }
+  const ModelFileHeader *header =
+      reinterpret_cast<const ModelFileHeader *>(base);
+  if (std::memcmp(header->magic, kModelFileMagic, sizeof(kModelFileMagic)) !=
+          0 ||
+      header->version != kModelFileVersion ||
+      _size < sizeof(ModelFileHeader) +
+                  header->module_count * sizeof(ModelFileRecord)) {
+    return false;
+  }
+
+  // a blob of count floats at offset must be aligned and inside the file
+  auto blob = [&](uint64_t offset, uint64_t count) -> const float * {
+    if (offset == 0 || offset % kModelFileAlignment != 0 ||
+        offset + count * sizeof(float) > _size) {
+      return nullptr;
+    }
+    return reinterpret_cast<const float *>(base + offset);
+  };
+
+  const ModelFileRecord *records =
+      reinterpret_cast<const ModelFileRecord *>(header + 1);
+  for (uint32_t i = 0; i < header->module_count; i++) {
+    const ModelFileRecord &record = records[i];
+    Layer layer;
+    layer.name.assign(record.name, strnlen(record.name, sizeof(record.name)));
+    layer.input_size = record.input_size;
+    layer.output_size = record.output_size;
+    layer.weights = nullptr;
+    layer.bias = nullptr;
+
+    if (layer.name == "Linear" || layer.name == "SparseLinear") {
+      layer.weights = blob(record.weights_offset,
+                           uint64_t(record.input_size) * record.output_size);
+      layer.bias = blob(record.bias_offset, record.output_size);
+      if (layer.weights == nullptr || layer.bias == nullptr) {
+        return false;
+      }
+    } else if (layer.name == "ReLU") {
+      layer.activation.reset(new Activations::ReLU());
+    } else if (layer.name == "Softmax") {
+      layer.activation.reset(new Activations::Softmax());
+    } else if (layer.name == "Identity") {
+      layer.activation.reset(new Activations::Identity());
+    } else {
+      std::cerr << "Unknown module in " << path << ": " << layer.name
+                << std::endl;
+      return false;
+    }
+    _layers.push_back(std::move(layer));
+  }
+  return true;
+}
+
+void MappedModel::predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  using WeightsMap = Eigen::Map<const Eigen::MatrixXf, Eigen::Aligned64>;
+  using BiasMap = Eigen::Map<const Eigen::RowVectorXf, Eigen::Aligned64>;
+
+  if (&out != &x) {
+    out = x;
+  }
+  for (Layer &layer : _layers) {
+    if (layer.activation) {
+      layer.activation->predict(out, out);
+      continue;
+    }
+    if (layer.name == "SparseLinear") {
+      out = out * WeightsMap(layer.weights, layer.output_size,
+                             layer.input_size)
+                      .transpose();
+    } else {
+      out = out * WeightsMap(layer.weights, layer.input_size,
+                             layer.output_size);
+    }
+    out.rowwise() += BiasMap(layer.bias, layer.output_size);
+  }
+}
+
+void MappedModel::printDescription() {
+  std::cout << "Mapped model (" << _size << " bytes):" << std::endl;
+  for (Layer &layer : _layers) {
+    std::cout << layer.name;
+    if (!layer.activation) {
+      std::cout << " [" << layer.input_size << ", " << layer.output_size
+                << "]";
+    }
+    std::cout << std::endl;
+  }
+}
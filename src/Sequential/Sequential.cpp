@@ -26,14 +26,18 @@
 #include "Sequential.hpp"
 #include "Common.hpp"
 #include "GlobalState.hpp"
+#include "Linear.hpp"
+#include "MappedModel.hpp"
 #include <algorithm>
 
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <mpi.h>
 
 using namespace DeepLearningFramework;
 
-Sequential::Sequential(std::vector<Module *> &model, Losses::MSE loss) {
+Sequential::Sequential(std::vector<Module *> &model, Losses::Loss &loss) {
   switch (globalParallelismMode()) {
   case DATA_PARALLELISM: {
     _model = model;
@@ -66,64 +70,102 @@ Sequential::Sequential(std::vector<Module *> &model, Losses::MSE loss) {
     _backward_flag = 0;
   }
 
-  _loss = loss;
+  _loss = &loss;
+
+  _workspace.activations.resize(_model.size());
+  _workspace.gradients.resize(_model.size());
+
+  setOptimizer(_default_optimizer);
 }
 
 void Sequential::forward(Eigen::MatrixXf &x, const std::string &mode) {
-  std::vector<Module *>::iterator it;
+  forward(x, x, mode);
+}
+
+void Sequential::forward(Eigen::MatrixXf &out, const Eigen::MatrixXf &x,
+                         const std::string &mode) {
+  if (mode == "train") {
+    syncParameters();
+  }
+
+  // Only training needs the inputs saved for backward; "calibrate" also
+  // quantizes each module on the input it sees.
+  auto apply = [&mode](Module *module, Eigen::MatrixXf &out,
+                       const Eigen::MatrixXf &in) {
+    if (mode == "train") {
+      module->forward(out, in);
+      return;
+    }
+    if (mode == "calibrate") {
+      module->quantize(in);
+    }
+    module->predict(out, in);
+  };
 
-  if (mode == "train" && globalParallelismMode() == DATA_PARALLELISM) {
-    if (globalTrainMode() == SYNC) {
-      PullParameters(globalTrainStatus());
+  if (globalParallelismMode() == DATA_PARALLELISM) {
+    if (mode == "train") {
+      // Each module writes into its own workspace buffer, so steady-state
+      // steps reuse the storage of the previous step.
+      const Eigen::MatrixXf *in = &x;
+      for (int m = 0; m < _model.size(); m++) {
+        apply(_model[m], _workspace.activations[m], *in);
+        in = &_workspace.activations[m];
+      }
+      out = *in;
     } else {
-      globalBackgroundThread().enqueue(PullParameters, globalTrainStatus());
+      if (&out != &x) {
+        out = x;
+      }
+      for (int m = 0; m < _model.size(); m++) {
+        apply(_model[m], out, out);
+      }
     }
+    return;
   }
 
+  if (&out != &x) {
+    out = x;
+  }
+  Eigen::MatrixXf &last_layer_out = _workspace.boundary;
   for (int m = 0; m < _model.size(); m++) {
-    if (globalParallelismMode() == DATA_PARALLELISM) {
-      _model[m]->forward(x, x);
-    } else {
-      std::vector<int> x_shape(2);
-      Eigen::MatrixXf last_layer_out;
-
-      if (m == 0) {
-        globalController().mpiForwardRecv(_forward_flag);
-        if (globalController().mpiRank() != 0 && _forward_flag) {
-          globalController().mpiForwardRecv(x_shape);
-          last_layer_out.resize(x_shape[0], x_shape[1]);
-          int count = x_shape[0] * x_shape[1];
-          float last_layer_out_array[count];
-
-          globalController().mpiForwardRecv(last_layer_out_array, count);
-          convertArrayToMatrix(last_layer_out_array, last_layer_out);
-        } else {
-          last_layer_out = x;
-        }
+    std::vector<int> x_shape(2);
+
+    if (m == 0) {
+      globalController().mpiForwardRecv(_forward_flag);
+      if (globalController().mpiRank() != 0 && _forward_flag) {
+        globalController().mpiForwardRecv(x_shape);
+        last_layer_out.resize(x_shape[0], x_shape[1]);
+        int count = x_shape[0] * x_shape[1];
+        float last_layer_out_array[count];
+
+        globalController().mpiForwardRecv(last_layer_out_array, count);
+        convertArrayToMatrix(last_layer_out_array, last_layer_out);
       } else {
-        last_layer_out = x;
+        last_layer_out = out;
       }
+    } else {
+      last_layer_out = out;
+    }
 
-      if (_forward_flag) {
-        _model[m]->forward(x, last_layer_out);
-      }
-      if (m != _model.size() - 1) {
-        continue;
-      }
-      x_shape[0] = x.rows();
-      x_shape[1] = x.cols();
+    if (_forward_flag) {
+      apply(_model[m], out, last_layer_out);
+    }
+    if (m != _model.size() - 1) {
+      continue;
+    }
+    x_shape[0] = out.rows();
+    x_shape[1] = out.cols();
 
-      float x_array[x.size()];
-      convertMatrixToArray(x, x_array);
-      globalController().mpiForwardSend(_forward_flag);
+    float x_array[out.size()];
+    convertMatrixToArray(out, x_array);
+    globalController().mpiForwardSend(_forward_flag);
 
-      globalController().mpiForwardSend(x_shape);
+    globalController().mpiForwardSend(x_shape);
 
-      globalController().mpiForwardSend(x_array, (int)x.size());
-      _forward_flag = 0;
-      if (mode != "train" && globalController().mpiRank() == 0) {
-        _forward_flag = 1;
-      }
+    globalController().mpiForwardSend(x_array, (int)out.size());
+    _forward_flag = 0;
+    if (mode != "train" && globalController().mpiRank() == 0) {
+      _forward_flag = 1;
     }
   }
   if (globalController().mpiRank() == globalController().mpiSize() - 1) {
@@ -131,69 +173,174 @@ void Sequential::forward(Eigen::MatrixXf &x, const std::string &mode) {
   }
 }
 
+void Sequential::forward(Eigen::MatrixXf &out, const SparseBatch &x,
+                         const std::string &mode) {
+  if (globalParallelismMode() != DATA_PARALLELISM || mode == "calibrate") {
+    forward(out, Eigen::MatrixXf(x), mode);
+    return;
+  }
+
+  // only the first module sees the sparse batch
+  if (mode == "train") {
+    syncParameters();
+    _model[0]->forwardSparse(_workspace.activations[0], x);
+    const Eigen::MatrixXf *in = &_workspace.activations[0];
+    for (int m = 1; m < _model.size(); m++) {
+      _model[m]->forward(_workspace.activations[m], *in);
+      in = &_workspace.activations[m];
+    }
+    out = *in;
+  } else {
+    _model[0]->predictSparse(out, x);
+    for (int m = 1; m < _model.size(); m++) {
+      _model[m]->predict(out, out);
+    }
+  }
+}
+
+void Sequential::forward(Eigen::MatrixXf &out, const IdBatch &x,
+                         const std::string &mode) {
+  if (globalParallelismMode() != DATA_PARALLELISM || mode == "calibrate") {
+    forward(out, x.cast<float>().eval(), mode);
+    return;
+  }
+
+  // only the first module sees the ids
+  if (mode == "train") {
+    syncParameters();
+    _model[0]->forwardIds(_workspace.activations[0], x);
+    const Eigen::MatrixXf *in = &_workspace.activations[0];
+    for (int m = 1; m < _model.size(); m++) {
+      _model[m]->forward(_workspace.activations[m], *in);
+      in = &_workspace.activations[m];
+    }
+    out = *in;
+  } else {
+    _model[0]->predictIds(out, x);
+    for (int m = 1; m < _model.size(); m++) {
+      _model[m]->predict(out, out);
+    }
+  }
+}
+
+void Sequential::syncParameters() {
+  // parameters only change once per accumulation window
+  if (globalParallelismMode() != DATA_PARALLELISM || _micro_step > 0) {
+    return;
+  }
+  if (globalTrainMode() == SYNC) {
+    PullParameters(globalTrainStatus());
+    parametersChanged();
+  } else {
+    const TrainStatus status = globalTrainStatus();
+    globalBackgroundThread().post([this, status]() {
+      PullParameters(status);
+      parametersChanged();
+    });
+  }
+}
+
+void Sequential::parametersChanged() {
+  for (Module *module : _model) {
+    module->parametersChanged();
+  }
+}
+
 void Sequential::backward(float &loss, const Eigen::MatrixXf &y,
                           Eigen::MatrixXf &y_pred) {
   int tag = 0;
-  Eigen::MatrixXf grad;
+  const bool accumulate = _accumulation_steps > 1;
+  std::vector<Module *>::iterator it;
+  for (it = _model.begin(); it != _model.end(); it++)
+    (*it)->accumulateGradients(accumulate && _micro_step > 0);
+
   if (globalParallelismMode() == DATA_PARALLELISM) {
     // calculate loss
-    _loss.forward(loss, y, y_pred);
+    _loss->forward(loss, y, y_pred);
 
-    // back propagation
-    _loss.backward(grad, y, y_pred);
-  } else {
-    if (globalController().mpiRank() == globalController().mpiSize() - 1) {
-      _loss.forward(loss, y, y_pred);
-      _loss.backward(grad, y, y_pred);
+    // back propagation, each module writes into its own workspace buffer
+    Eigen::MatrixXf *grad = &_workspace.loss_gradient;
+    _loss->backward(*grad, y, y_pred);
+
+    for (int m = _model.size() - 1; m > -1; m--) {
+      // with accumulation, parameter gradients are exchanged once per window
+      // instead. A row-sparse gradient depends on the features of each rank,
+      // so a module holding one exchanges its parameter gradients.
+      std::vector<Parameter> &sparse = _sparse_parameters[m];
+      if (!accumulate && sparse.empty() &&
+          !_model[m]->exchangesGradients()) {
+        if (globalTrainMode() == SYNC) {
+          PushGradients(globalTrainStatus(), *grad, tag);
+        } else {
+          // the task gets a copy of grad, which the next step overwrites.
+          // Swapping grad with the slot's buffer instead would hand this
+          // workspace entry a buffer another module posted a lap earlier,
+          // of another shape, and the next backward would reallocate it.
+          const TrainStatus status = globalTrainStatus();
+          globalBackgroundThread().post(
+              [status, tag](Eigen::Map<Eigen::MatrixXf> &grad) {
+                PushGradientBuffer(status, grad.data(), grad.size(), tag);
+              },
+              *grad);
+        }
+      }
+      _model[m]->backward(_workspace.gradients[m], *grad);
+      if (!accumulate && !sparse.empty()) {
+        pushParameterGradients(sparse);
+      }
+      grad = &_workspace.gradients[m];
+      tag++;
+    }
+    if (++_micro_step == _accumulation_steps) {
+      applyAccumulatedGradients();
     }
+    return;
+  }
+
+  Eigen::MatrixXf &grad = _workspace.loss_gradient;
+  if (globalController().mpiRank() == globalController().mpiSize() - 1) {
+    _loss->forward(loss, y, y_pred);
+    _loss->backward(grad, y, y_pred);
   }
 
+  Eigen::MatrixXf &last_layer_out = _workspace.boundary;
   for (int m = _model.size() - 1; m > -1; m--) {
-    if (globalParallelismMode() == DATA_PARALLELISM) {
-      if (globalTrainMode() == SYNC) {
-        PushGradients(globalTrainStatus(), grad, tag);
-      } else {
-        globalBackgroundThread().enqueue(PushGradients, globalTrainStatus(),
-                                         grad, tag);
-      }
-      _model[m]->backward(grad, grad);
-      tag++;
-    } else {
-      std::vector<int> grad_shape(2);
-      Eigen::MatrixXf last_layer_out;
-      if (m == _model.size() - 1) {
-        globalController().mpiBackwardRecv(_backward_flag);
-        if (globalController().mpiRank() != globalController().mpiSize() - 1) {
-          globalController().mpiBackwardRecv(grad_shape);
-          last_layer_out.resize(grad_shape[0], grad_shape[1]);
-          int count = grad_shape[0] * grad_shape[1];
-          float last_layer_out_array[count];
-          globalController().mpiBackwardRecv(last_layer_out_array, count);
-          convertArrayToMatrix(last_layer_out_array, last_layer_out);
-        } else {
-          last_layer_out = grad;
-        }
+    std::vector<int> grad_shape(2);
+    if (m == _model.size() - 1) {
+      globalController().mpiBackwardRecv(_backward_flag);
+      if (globalController().mpiRank() != globalController().mpiSize() - 1) {
+        globalController().mpiBackwardRecv(grad_shape);
+        last_layer_out.resize(grad_shape[0], grad_shape[1]);
+        int count = grad_shape[0] * grad_shape[1];
+        float last_layer_out_array[count];
+        globalController().mpiBackwardRecv(last_layer_out_array, count);
+        convertArrayToMatrix(last_layer_out_array, last_layer_out);
       } else {
         last_layer_out = grad;
       }
+    } else {
+      last_layer_out = grad;
+    }
 
-      if (_backward_flag) {
-        _model[m]->backward(grad, last_layer_out);
-        tag++;
-      }
-      if (m > 0) {
-        continue;
-      }
-      grad_shape[0] = grad.rows();
-      grad_shape[1] = grad.cols();
-
-      float grad_array[grad.size()];
-      convertMatrixToArray(grad, grad_array);
-      globalController().mpiBackwardSend(grad_shape);
-      globalController().mpiBackwardSend(_backward_flag);
-      globalController().mpiBackwardSend(grad_array, grad.size());
-      _backward_flag = 0;
+    if (_backward_flag) {
+      _model[m]->backward(grad, last_layer_out);
+      tag++;
     }
+    if (m > 0) {
+      continue;
+    }
+    grad_shape[0] = grad.rows();
+    grad_shape[1] = grad.cols();
+
+    float grad_array[grad.size()];
+    convertMatrixToArray(grad, grad_array);
+    globalController().mpiBackwardSend(grad_shape);
+    globalController().mpiBackwardSend(_backward_flag);
+    globalController().mpiBackwardSend(grad_array, grad.size());
+    _backward_flag = 0;
+  }
+  if (++_micro_step == _accumulation_steps) {
+    applyAccumulatedGradients();
   }
 
   if (globalController().mpiRank() == 0) {
@@ -201,20 +348,158 @@ void Sequential::backward(float &loss, const Eigen::MatrixXf &y,
   }
 }
 
-void Sequential::setLR(float lr) {
+void Sequential::pushParameterGradients(std::vector<Parameter> &parameters) {
+  if (globalTrainMode() == SYNC) {
+    PushParameterGradients(globalTrainStatus(), parameters);
+  } else {
+    // keep all communication on the background thread
+    const TrainStatus status = globalTrainStatus();
+    globalBackgroundThread().run([&parameters, &status]() {
+      PushParameterGradients(status, parameters);
+    });
+  }
+}
+
+void Sequential::applyAccumulatedGradients() {
+  if (globalParallelismMode() == DATA_PARALLELISM &&
+      _accumulation_steps > 1) {
+    pushParameterGradients(_parameters);
+  }
+  _optimizer->step(1.f / _micro_step);
+  parametersChanged();
+  _micro_step = 0;
+}
+
+void Sequential::flushGradients() {
+  if (_micro_step > 0) {
+    applyAccumulatedGradients();
+  }
+}
+
+void Sequential::setGradientAccumulation(int steps) {
+  flushGradients();
+  _accumulation_steps = std::max(steps, 1);
+}
+
+void Sequential::quantize(const Eigen::MatrixXf &x) {
+  Eigen::MatrixXf sample = x;
+  forward(sample, "calibrate");
+}
+
+void Sequential::dequantize() {
   std::vector<Module *>::iterator it;
   for (it = _model.begin(); it != _model.end(); it++)
-    (*it)->setLR(lr);
+    (*it)->dequantize();
 }
 
-uint32_t Sequential::getParametersCount() {
-  uint32_t parametersCount = 0;
+bool Sequential::save(const std::string &path) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Could not open the file: " << path << std::endl;
+    return false;
+  }
+  return save(file);
+}
+
+bool Sequential::save(std::ostream &file) {
+  auto align = [](uint64_t offset) {
+    return (offset + kModelFileAlignment - 1) / kModelFileAlignment *
+           kModelFileAlignment;
+  };
+
+  ModelFileHeader header;
+  std::memcpy(header.magic, kModelFileMagic, sizeof(header.magic));
+  header.version = kModelFileVersion;
+  header.module_count = _model.size();
+
+  // lay out the records, then the weights and bias of each linear layer
+  std::vector<ModelFileRecord> records(_model.size());
+  std::vector<Eigen::MatrixXf> blobs;
+  uint64_t offset = sizeof(header) + records.size() * sizeof(ModelFileRecord);
+  for (int m = 0; m < _model.size(); m++) {
+    ModelFileRecord &record = records[m];
+    std::memset(&record, 0, sizeof(record));
+    std::string name = _model[m]->getName();
+    std::strncpy(record.name, name.c_str(), sizeof(record.name));
+
+    if (name == "Linear" || name == "SparseLinear") {
+      Layers::Linear *linear = static_cast<Layers::Linear *>(_model[m]);
+      blobs.push_back(linear->getWeights());
+      blobs.push_back(linear->getBias());
+      record.output_size = blobs.back().cols();
+      record.input_size = blobs[blobs.size() - 2].size() / record.output_size;
+      record.weights_offset = offset = align(offset);
+      offset += blobs[blobs.size() - 2].size() * sizeof(float);
+      record.bias_offset = offset = align(offset);
+      offset += blobs.back().size() * sizeof(float);
+    } else if (name != "ReLU" && name != "Softmax" && name != "Identity") {
+      std::cerr << "Cannot export module: " << name << std::endl;
+      return false;
+    }
+  }
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(records.data()),
+             records.size() * sizeof(ModelFileRecord));
+  offset = sizeof(header) + records.size() * sizeof(ModelFileRecord);
+  for (const Eigen::MatrixXf &blob : blobs) {
+    const uint64_t start = align(offset);
+    const std::vector<char> padding(start - offset, 0);
+    file.write(padding.data(), padding.size());
+    file.write(reinterpret_cast<const char *>(blob.data()),
+               blob.size() * sizeof(float));
+    offset = start + blob.size() * sizeof(float);
+  }
+  return static_cast<bool>(file);
+}
+
+void Sequential::setLR(float lr) { _optimizer->setLR(lr); }
+
+void Sequential::setOptimizer(Optimizers::Optimizer &optimizer) {
+  _parameters.clear();
+  _sparse_parameters.assign(_model.size(), std::vector<Parameter>());
+  for (int m = 0; m < _model.size(); m++) {
+    const size_t first = _parameters.size();
+    _model[m]->collectParameters(_parameters);
+    for (size_t i = first; i < _parameters.size(); i++) {
+      if (_parameters[i].sparse != nullptr && !_parameters[i].exchanged) {
+        _sparse_parameters[m].assign(_parameters.begin() + first,
+                                     _parameters.end());
+        break;
+      }
+    }
+  }
+
+  _optimizer = &optimizer;
+  _optimizer->setParameters(_parameters);
+}
+
+bool Sequential::exchangesGradients() {
+  std::vector<Module *>::iterator it;
+  for (it = _model.begin(); it != _model.end(); it++)
+    if ((*it)->exchangesGradients())
+      return true;
+  return false;
+}
+
+bool Sequential::takesClassLabels() { return _loss->takesClassLabels(); }
+
+int64_t Sequential::getParametersCount() {
+  int64_t parametersCount = 0;
   std::vector<Module *>::iterator it;
   for (it = _model.begin(); it != _model.end(); it++)
     parametersCount += (*it)->getParametersCount();
   return parametersCount;
 }
 
+size_t Sequential::getSavedActivationBytes() {
+  size_t bytes = 0;
+  std::vector<Module *>::iterator it;
+  for (it = _model.begin(); it != _model.end(); it++)
+    bytes += (*it)->getSavedActivationBytes();
+  return bytes;
+}
+
 void Sequential::printDescription() {
   // layer description
   std::cout << "Model:" << std::endl;
@@ -224,7 +509,11 @@ void Sequential::printDescription() {
 
   // loss
   std::cout << "\nWith loss:" << std::endl;
-  _loss.printDescription();
+  _loss->printDescription();
+
+  // optimizer
+  std::cout << "\nWith optimizer:" << std::endl;
+  _optimizer->printDescription();
 
   // parameters count
   std::cout << "\nNumber of parameters:" << this->getParametersCount()
@@ -0,0 +1,436 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * InferenceServer class implementation
+ */
+
+#include "InferenceServer.hpp"
+#include "Common.hpp"
+#include <algorithm>
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace DeepLearningFramework;
+
+namespace {
+// latencies kept for the percentiles
+constexpr size_t kMaxLatencySamples = 1 << 20;
+
+const std::chrono::milliseconds kPollInterval(100);
+
+void writeLine(int fd, const std::string &line) {
+  std::string data = line + "\n";
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return;
+    }
+    sent += n;
+  }
+}
+} // namespace
+
+InferenceServer::InferenceServer(Sequential &model, int feature_dim,
+                                 const ServerOptions &options)
+    : _model(model), _feature_dim(feature_dim), _options(options),
+      _stop(false) {}
+
+InferenceServer::~InferenceServer() {
+  stop();
+  for (std::thread &thread : _threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+void InferenceServer::serve() {
+  const bool pipeline = globalParallelismMode() == PIPELINE_MODEL_PARALLELISM;
+  if (globalController().mpiRank() != 0) {
+    if (pipeline) {
+      serveStage();
+    }
+    return;
+  }
+
+  _start = _last_report = std::chrono::steady_clock::now();
+  int listen_fd = openSocket();
+  if (listen_fd >= 0) {
+    _threads.emplace_back(&InferenceServer::acceptLoop, this, listen_fd);
+  } else {
+    stop();
+  }
+
+  if (pipeline) {
+    servePipeline();
+  } else {
+    while (!_stop) {
+      Batch batch = nextBatch(kPollInterval);
+      if (!batch.empty()) {
+        Eigen::MatrixXf out = stack(batch);
+        _model.forward(out, "predict");
+        complete(batch, out);
+      }
+      report();
+    }
+  }
+
+  // requests that arrived too late get an empty response, before joining
+  // the connections waiting for them; no request is queued after _stop
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+    for (std::shared_ptr<Request> &request : _queue) {
+      request->response.set_value(std::vector<float>());
+    }
+    _queue.clear();
+  }
+  _cv.notify_all();
+  for (std::thread &thread : _threads) {
+    thread.join();
+  }
+  _threads.clear();
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    if (!_options.unix_path.empty()) {
+      unlink(_options.unix_path.c_str());
+    }
+  }
+  report(true);
+}
+
+void InferenceServer::servePipeline() {
+  MPIController &global_controller = globalController();
+  const size_t stages = global_controller.mpiSize();
+  std::deque<Batch> in_flight;
+
+  while (!_stop || !in_flight.empty()) {
+    Batch batch;
+    if (!_stop) {
+      batch = nextBatch(in_flight.empty() ? kPollInterval
+                                          : std::chrono::milliseconds(0));
+    }
+    if (!batch.empty()) {
+      // sent on to the next stage, the output comes back later
+      Eigen::MatrixXf x = stack(batch), out;
+      _model.forward(out, x, "predict");
+      in_flight.push_back(std::move(batch));
+    }
+
+    // wait for a result when there is nothing new to feed or every stage is
+    // busy, otherwise only take the results already there
+    bool block = batch.empty() || in_flight.size() >= stages;
+    while (!in_flight.empty() &&
+           (block || global_controller.mpiResultReady())) {
+      receiveResult(in_flight);
+      block = false;
+    }
+    report();
+  }
+
+  // an empty batch stops the other stages
+  Eigen::MatrixXf empty(0, _feature_dim), out;
+  _model.forward(out, empty, "predict");
+}
+
+void InferenceServer::serveStage() {
+  MPIController &global_controller = globalController();
+  const bool last =
+      global_controller.mpiRank() == global_controller.mpiSize() - 1;
+
+  Eigen::MatrixXf x, out;
+  while (true) {
+    _model.forward(out, x, "predict");
+    if (out.rows() == 0) {
+      return;
+    }
+    if (last) {
+      std::vector<int> shape = {static_cast<int>(out.rows()),
+                                static_cast<int>(out.cols())};
+      std::vector<float> values(out.size());
+      convertMatrixToArray(out, values.data());
+      global_controller.mpiResultSend(shape);
+      global_controller.mpiResultSend(values.data(), values.size());
+    }
+  }
+}
+
+void InferenceServer::receiveResult(std::deque<Batch> &in_flight) {
+  MPIController &global_controller = globalController();
+  std::vector<int> shape(2);
+  global_controller.mpiResultRecv(shape);
+  Eigen::MatrixXf out(shape[0], shape[1]);
+  std::vector<float> values(out.size());
+  global_controller.mpiResultRecv(values.data(), values.size());
+  convertArrayToMatrix(values.data(), out);
+
+  complete(in_flight.front(), out);
+  in_flight.pop_front();
+}
+
+void InferenceServer::stop() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _cv.notify_all();
+}
+
+InferenceServer::Batch
+InferenceServer::nextBatch(std::chrono::milliseconds wait) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _cv.wait_for(lock, wait, [this]() { return _stop || !_queue.empty(); });
+  if (_queue.empty()) {
+    return Batch();
+  }
+
+  // give other requests until the deadline of the first one to join
+  const size_t max_batch_size = std::max(_options.max_batch_size, 1);
+  const auto deadline =
+      _queue.front()->arrival +
+      std::chrono::microseconds(
+          static_cast<int64_t>(_options.max_latency_ms * 1000));
+  _cv.wait_until(lock, deadline, [this, max_batch_size]() {
+    return _stop || _queue.size() >= max_batch_size;
+  });
+
+  const size_t size = std::min(_queue.size(), max_batch_size);
+  Batch batch(_queue.begin(), _queue.begin() + size);
+  _queue.erase(_queue.begin(), _queue.begin() + size);
+  return batch;
+}
+
+Eigen::MatrixXf InferenceServer::stack(const Batch &batch) {
+  Eigen::MatrixXf x(batch.size(), _feature_dim);
+  for (size_t i = 0; i < batch.size(); i++) {
+    x.row(i) = Eigen::Map<const Eigen::RowVectorXf>(
+        batch[i]->features.data(), _feature_dim);
+  }
+  return x;
+}
+
+void InferenceServer::complete(Batch &batch, const Eigen::MatrixXf &out) {
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(_stats_mutex);
+  for (size_t i = 0; i < batch.size(); i++) {
+    std::vector<float> row(out.cols());
+    Eigen::Map<Eigen::RowVectorXf>(row.data(), row.size()) = out.row(i);
+    batch[i]->response.set_value(row);
+    _requests++;
+
+    std::chrono::duration<double, std::milli> latency =
+        now - batch[i]->arrival;
+    _latencies_ms.push_back(latency.count());
+  }
+  if (_latencies_ms.size() > kMaxLatencySamples) {
+    _latencies_ms.erase(_latencies_ms.begin(),
+                        _latencies_ms.begin() + _latencies_ms.size() / 2);
+  }
+  _batches++;
+}
+
+void InferenceServer::acceptLoop(int listen_fd) {
+  while (!_stop) {
+    pollfd poll_fd = {listen_fd, POLLIN, 0};
+    if (poll(&poll_fd, 1, kPollInterval.count()) <= 0) {
+      continue;
+    }
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    // connections run detached, counted until they end
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _connections++;
+    }
+    std::thread(&InferenceServer::connectionLoop, this, fd).detach();
+  }
+  std::unique_lock<std::mutex> lock(_mutex);
+  _cv.wait(lock, [this]() { return _connections == 0; });
+}
+
+void InferenceServer::connectionLoop(int fd) {
+  std::string pending;
+  char buffer[4096];
+  while (!_stop) {
+    pollfd poll_fd = {fd, POLLIN, 0};
+    int ready = poll(&poll_fd, 1, kPollInterval.count());
+    if (ready == 0) {
+      continue;
+    }
+    ssize_t n = ready > 0 ? read(fd, buffer, sizeof(buffer)) : -1;
+    if (n <= 0) {
+      break;
+    }
+    pending.append(buffer, n);
+
+    size_t end;
+    while ((end = pending.find('\n')) != std::string::npos) {
+      std::string line = pending.substr(0, end);
+      pending.erase(0, end + 1);
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+
+      if (line == "shutdown") {
+        writeLine(fd, "ok");
+        stop();
+        break;
+      }
+
+      std::replace(line.begin(), line.end(), ',', ' ');
+      std::stringstream line_stream(line);
+      std::shared_ptr<Request> request = std::make_shared<Request>();
+      float value;
+      while (line_stream >> value) {
+        request->features.push_back(value);
+      }
+      if (request->features.size() != static_cast<size_t>(_feature_dim)) {
+        writeLine(fd, "error: expected " + std::to_string(_feature_dim) +
+                          " features");
+        continue;
+      }
+
+      std::future<std::vector<float>> response = request->response.get_future();
+      request->arrival = std::chrono::steady_clock::now();
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stop) {
+          request->response.set_value(std::vector<float>());
+        } else {
+          _queue.push_back(request);
+        }
+      }
+      _cv.notify_all();
+
+      std::vector<float> output = response.get();
+      if (output.empty()) {
+        writeLine(fd, "error: server stopped");
+        continue;
+      }
+      std::ostringstream reply;
+      for (size_t i = 0; i < output.size(); i++) {
+        reply << (i > 0 ? "," : "") << output[i];
+      }
+      writeLine(fd, reply.str());
+    }
+  }
+  close(fd);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _connections--;
+  _cv.notify_all();
+}
+
+int InferenceServer::openSocket() {
+  int fd = -1;
+  std::string address;
+  int ret = -1;
+  if (!_options.unix_path.empty()) {
+    address = _options.unix_path;
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(address.c_str());
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0) {
+      ret = bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    }
+  } else {
+    address = "127.0.0.1:" + std::to_string(_options.port);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(_options.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0) {
+      int reuse = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+      ret = bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    }
+  }
+
+  if (ret < 0 || listen(fd, SOMAXCONN) < 0) {
+    std::cerr << "Could not listen on " << address << ": "
+              << std::strerror(errno) << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  Log() << "Serving on " << address << ", max batch size "
+        << _options.max_batch_size << ", max latency "
+        << _options.max_latency_ms << " ms";
+  return fd;
+}
+
+ServerStats InferenceServer::stats() {
+  std::lock_guard<std::mutex> lock(_stats_mutex);
+  ServerStats stats;
+  stats.requests = _requests;
+  stats.batches = _batches;
+  if (!_latencies_ms.empty()) {
+    std::vector<double> sorted(_latencies_ms);
+    auto percentile = [&sorted](double q) {
+      size_t k = std::min(sorted.size() - 1,
+                          static_cast<size_t>(q * sorted.size()));
+      std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+      return sorted[k];
+    };
+    stats.p50_ms = percentile(0.50);
+    stats.p99_ms = percentile(0.99);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - _start;
+  if (elapsed.count() > 0) {
+    stats.throughput = stats.requests / elapsed.count();
+  }
+  return stats;
+}
+
+void InferenceServer::report(bool force) {
+  const auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double> since_report = now - _last_report;
+  if (!force && (_options.report_interval_s <= 0 ||
+                 since_report.count() < _options.report_interval_s)) {
+    return;
+  }
+  _last_report = now;
+
+  ServerStats served = stats();
+  Log() << "Served " << served.requests << " requests in " << served.batches
+        << " batches, p50 latency: " << served.p50_ms
+        << " ms, p99 latency: " << served.p99_ms
+        << " ms, throughput: " << served.throughput << " requests/s";
+}
@@ -0,0 +1,219 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Evaluator class implementation
+ */
+
+#include "Evaluator.hpp"
+#include "GlobalState.hpp"
+#include "Metrics.hpp"
+#include "Random.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using namespace DeepLearningFramework;
+
+namespace {
+/* Copy the listed rows of source into chunk, column by column. */
+void gatherRows(Eigen::MatrixXf &chunk, const Eigen::MatrixXf &source,
+                const int64_t *rows, Eigen::Index count) {
+  chunk.resize(count, source.cols());
+  for (Eigen::Index c = 0; c < source.cols(); ++c) {
+    const float *column = source.col(c).data();
+    float *out = chunk.col(c).data();
+    for (Eigen::Index r = 0; r < count; ++r) {
+      out[r] = column[rows[r]];
+    }
+  }
+}
+
+int64_t countCorrect(const Eigen::MatrixXf &labels,
+                     const Eigen::MatrixXf &pred) {
+  float accuracy = 0.f;
+  Metrics::accuracy(accuracy, labels, pred);
+  return std::llround(accuracy * labels.rows());
+}
+} // namespace
+
+Evaluator::Evaluator(const EvaluationOptions &options) : _options(options) {}
+
+Evaluator::~Evaluator() {
+  if (_worker.joinable()) {
+    _worker.join();
+  }
+}
+
+template <typename Job> void Evaluator::schedule(const Job &job) {
+  if (!isAsync()) {
+    job();
+    return;
+  }
+  // one job at a time: modules keep per-call buffers
+  std::thread previous = std::move(_worker);
+  _worker = std::thread(
+      [job](std::thread previous) {
+        if (previous.joinable()) {
+          previous.join();
+        }
+        job();
+      },
+      std::move(previous));
+}
+
+void Evaluator::predict(Eigen::MatrixXf &out, const Eigen::MatrixXf &x) {
+  if (_snapshot) {
+    _snapshot->predict(out, x);
+  } else {
+    _model->forward(out, x, "predict");
+  }
+}
+
+void Evaluator::snapshot(Sequential &model) {
+  _model = &model;
+  _snapshot.reset();
+  // other modes need every rank in each "predict" pass
+  if (!_options.async || (globalParallelismMode() != DATA_PARALLELISM &&
+                          globalController().mpiSize() > 1)) {
+    return;
+  }
+  std::ostringstream image;
+  if (!model.save(image)) {
+    // scored synchronously from now on
+    _options.async = false;
+    return;
+  }
+  const std::string bytes = image.str();
+  _snapshot.reset(new MappedModel(bytes.data(), bytes.size()));
+  if (!_snapshot->isLoaded()) {
+    _snapshot.reset();
+  }
+}
+
+void Evaluator::evaluate(const Eigen::MatrixXf &labels,
+                         const Eigen::MatrixXf &features) {
+  _counts.push_back(Count{0, 0});
+  Count &count = _counts.back();
+  const uint32_t draw = _draws++;
+  schedule([this, &count, &labels, &features, draw]() {
+    score(count, labels, features, draw);
+  });
+}
+
+void Evaluator::evaluate(BatchStream &stream) {
+  _counts.push_back(Count{0, 0});
+  Count &count = _counts.back();
+  schedule([this, &count, &stream]() { score(count, stream); });
+}
+
+void Evaluator::add(int64_t correct, int64_t rows) {
+  _counts.push_back(Count{correct, rows});
+}
+
+std::vector<float> Evaluator::collect() {
+  if (_worker.joinable()) {
+    _worker.join();
+  }
+  std::vector<int64_t> local;
+  for (const Count &count : _counts) {
+    local.push_back(count.correct);
+    local.push_back(count.rows);
+  }
+  std::vector<int64_t> total(local.size());
+  if (!local.empty()) {
+    runCollective([&local, &total]() {
+      globalController().mpiAllreduce<int64_t>(local.data(), total.data(),
+                                               local.size(), MPI_SUM);
+    });
+  }
+
+  std::vector<float> accuracy;
+  for (size_t i = 0; i < total.size(); i += 2) {
+    accuracy.push_back(total[i + 1] > 0 ? float(total[i]) / total[i + 1]
+                                        : 0.f);
+  }
+  _counts.clear();
+  _snapshot.reset();
+  _model = nullptr;
+  return accuracy;
+}
+
+void Evaluator::score(Count &count, const Eigen::MatrixXf &labels,
+                      const Eigen::MatrixXf &features, uint32_t draw) {
+  // pipeline stages before the last hold no labels but run every pass
+  const bool has_labels = labels.size() > 0;
+  const Eigen::Index rows = features.rows();
+  Eigen::Index scored = rows;
+  if (_options.sample_fraction < 1.f) {
+    scored = std::min<Eigen::Index>(
+        rows, std::ceil(_options.sample_fraction * rows));
+    // each rank draws from its own shard in data parallelism, otherwise all
+    // ranks draw the same rows
+    const uint32_t index = globalParallelismMode() == DATA_PARALLELISM
+                               ? globalController().mpiRank()
+                               : 0;
+    randomPermutation(_order, rows, {EVAL_RANDOM, index, draw});
+    _order.resize(scored);
+    std::sort(_order.begin(), _order.end());
+  }
+
+  const Eigen::Index chunk_rows =
+      std::max<Eigen::Index>(_options.chunk_rows, 1);
+  for (Eigen::Index begin = 0; begin < scored; begin += chunk_rows) {
+    const Eigen::Index n = std::min(chunk_rows, scored - begin);
+    if (scored < rows) {
+      gatherRows(_chunk, features, _order.data() + begin, n);
+      if (has_labels) {
+        gatherRows(_chunk_labels, labels, _order.data() + begin, n);
+      }
+    } else {
+      _chunk = features.middleRows(begin, n);
+      if (has_labels) {
+        _chunk_labels = labels.middleRows(begin, n);
+      }
+    }
+    predict(_chunk_pred, _chunk);
+    if (has_labels) {
+      count.correct += countCorrect(_chunk_labels, _chunk_pred);
+      count.rows += n;
+    }
+  }
+}
+
+void Evaluator::score(Count &count, BatchStream &stream) {
+  Eigen::Index batches = stream.batchCount();
+  if (_options.sample_fraction < 1.f) {
+    batches = std::ceil(_options.sample_fraction * batches);
+  }
+  Eigen::Index b = 0;
+  for (const BatchStream::Batch &batch : stream) {
+    if (b++ == batches) {
+      break;
+    }
+    predict(_chunk_pred, batch.features);
+    if (batch.labels.size() > 0) {
+      count.correct += countCorrect(batch.labels, _chunk_pred);
+      count.rows += batch.labels.rows();
+    }
+  }
+}
@@ -25,14 +25,103 @@
 
 #include "Trainer.hpp"
 
+#include <cmath>
+
 using namespace DeepLearningFramework;
 
-void Trainer::addAccuracy(std::vector<float> &accuracyHistory,
-                            Sequential &model, const Eigen::MatrixXf &labels,
-                            const Eigen::MatrixXf &features) {
-  Eigen::MatrixXf tmpFeatures = features;
-  model.forward(tmpFeatures, "predict");
-  float accuracy = 0.f;
-  Metrics::accuracy(accuracy, labels, tmpFeatures);
-  accuracyHistory.push_back(accuracy);
+void Trainer::reportEpoch(Evaluator &evaluator, const EpochReport &report,
+                          std::vector<float> &train_acc,
+                          std::vector<float> &test_acc, uint32_t step) {
+  std::vector<float> accuracy = evaluator.collect();
+  train_acc.push_back(accuracy[0]);
+  test_acc.push_back(accuracy[1]);
+
+  if (report.epoch % step == 0)
+    Log() << "Epoch: " << report.epoch
+          << ", train accuracy: " << train_acc.back()
+          << ", loss: " << report.loss
+          << ", test accuracy: " << test_acc.back()
+          << ", train time: " << report.train_ms << " ms"
+#ifdef PICOPEBBLE_COUNT_ALLOCATIONS
+          << ", max heap allocations per step: "
+          << report.max_step_allocations
+#endif
+          ;
+}
+
+void Trainer::trainModel(std::vector<float> &train_acc,
+                         std::vector<float> &test_acc, Sequential &model,
+                         uint32_t epochs, BatchStream &train,
+                         BatchStream &test, uint32_t step) {
+  uint32_t batch_num = train.batchCount();
+  // modules exchanging data in every step need all ranks in lockstep
+  if (globalParallelismMode() == DATA_PARALLELISM &&
+      model.exchangesGradients()) {
+    uint32_t local_batch_num = batch_num;
+    globalController().mpiAllreduce<uint32_t>(&local_batch_num, &batch_num, 1,
+                                              MPI_MIN);
+  }
+
+  // set the flag for stopping synchronization parameters.
+  trainFinishFlag().setStatus(epochs - 1, batch_num - 1);
+
+  // labels come one-hot encoded from the prefetch thread
+  const bool one_hot = !model.takesClassLabels();
+  train.encodeLabels(one_hot);
+  Eigen::MatrixXf y_pred;
+  Evaluator evaluator;
+  EpochReport report;
+
+  for (uint32_t i = 0; i < epochs; i++) {
+    float loss = 0.f;
+    float correct = 0.f;
+    Eigen::Index seen = 0;
+    size_t max_step_allocations = 0;
+    auto epoch_start = std::chrono::steady_clock::now();
+    uint32_t batch_idx = 0;
+    for (const BatchStream::Batch &batch : train) {
+      if (batch_idx == batch_num) {
+        break;
+      }
+      float batch_loss = 0.f;
+      globalTrainStatus().setStatus(i, batch_idx);
+      size_t allocations = allocationCount();
+
+      model.forward(y_pred, batch.features);
+      float accuracy = 0.f;
+      Metrics::accuracy(accuracy, batch.labels, y_pred);
+      correct += accuracy * batch.labels.rows();
+      seen += batch.labels.rows();
+
+      model.backward(batch_loss, one_hot ? batch.one_hot_labels : batch.labels,
+                     y_pred);
+      loss += batch_loss;
+
+      // the first step sizes the workspace
+      if (i > 0 || batch_idx > 0) {
+        max_step_allocations = std::max(max_step_allocations,
+                                        allocationCount() - allocations);
+      }
+      batch_idx++;
+    }
+    // apply a partial accumulation window before evaluating
+    model.flushGradients();
+    std::chrono::duration<double, std::milli> epoch_time =
+        std::chrono::steady_clock::now() - epoch_start;
+
+    // the previous round ran in the background during this epoch
+    if (evaluator.isPending()) {
+      reportEpoch(evaluator, report, train_acc, test_acc, step);
+    }
+    evaluator.snapshot(model);
+    evaluator.add(std::llround(correct), seen);
+    evaluator.evaluate(test);
+    report = {i, loss / batch_num, epoch_time.count(), max_step_allocations};
+    if (!evaluator.isAsync()) {
+      reportEpoch(evaluator, report, train_acc, test_acc, step);
+    }
+  }
+  if (evaluator.isPending()) {
+    reportEpoch(evaluator, report, train_acc, test_acc, step);
+  }
 }
@@ -24,26 +24,53 @@
  * Template function from Trainer class implementation
  */
 
+#include "AllocationCounter.hpp"
 #include "Common.hpp"
+#include "Random.hpp"
 #include <chrono>
 #include <cmath>
 #include <thread>
 
 using namespace DeepLearningFramework;
 
-inline Eigen::MatrixXf oneHotEncoding(const Eigen::MatrixXf &input) {
+inline void oneHotEncoding(Eigen::MatrixXf &one_hot,
+                           const Eigen::MatrixXf &input, int N_classes) {
   /* Transform labels into one-hot encoding:
    * 0  ->  0 0 0
    * 1  ->  0 1 0
    * 2  ->  0 0 1
    * */
   int n = input.rows();
-  int N_classes = input.maxCoeff() + 1;
-  Eigen::MatrixXf one_hot = Eigen::MatrixXf::Zero(n, N_classes);
+  one_hot.resize(n, N_classes);
+  one_hot.setZero();
   for (int i = 0; i < n; ++i) {
     one_hot(i, static_cast<int>(input(i))) = 1.0;
   }
-  return one_hot;
+}
+
+/* Gather the rows of source listed in order into consecutive batches, each
+ * one contiguous, column by column. */
+inline void gatherBatches(std::vector<Eigen::MatrixXf> &batches,
+                          const Eigen::MatrixXf &source,
+                          const std::vector<int64_t> &order) {
+  if (batches.empty()) {
+    return;
+  }
+  const Eigen::Index batch_rows = batches[0].rows();
+  parallelFor(batches.size(), batch_rows * source.cols(),
+              [&](Eigen::Index begin, Eigen::Index end) {
+                for (Eigen::Index b = begin; b < end; ++b) {
+                  const int64_t *rows = order.data() + b * batch_rows;
+                  Eigen::MatrixXf &batch = batches[b];
+                  for (Eigen::Index c = 0; c < batch.cols(); ++c) {
+                    const float *column = source.col(c).data();
+                    float *out = batch.col(c).data();
+                    for (Eigen::Index r = 0; r < batch.rows(); ++r) {
+                      out[r] = column[rows[r]];
+                    }
+                  }
+                }
+              });
 }
 
 template <uint32_t batch_size, uint32_t feature_dim>
@@ -54,34 +81,93 @@ void Trainer::trainModel(std::vector<float> train_acc,
                          const Eigen::MatrixXf &y_test,
                          const Eigen::MatrixXf &X_test, uint32_t step) {
 
-  uint32_t batch_num = X_train.rows() / batch_size;
+  // the trailing rows make a last, smaller batch
+  const uint32_t rows = X_train.rows();
+  uint32_t batch_num = (rows + batch_size - 1) / batch_size;
+  // modules exchanging data in every step need all ranks in lockstep
+  if (globalParallelismMode() == DATA_PARALLELISM &&
+      model.exchangesGradients()) {
+    uint32_t local_batch_num = batch_num;
+    globalController().mpiAllreduce<uint32_t>(&local_batch_num, &batch_num, 1,
+                                              MPI_MIN);
+  }
 
   // set the flag for stopping synchronization parameters.
   trainFinishFlag().setStatus(epochs - 1, batch_num - 1);
 
+  // labels are encoded once, not in every step; pipeline stages other than
+  // the last have none
+  const bool one_hot = !model.takesClassLabels();
+  Eigen::MatrixXf y_one_hot;
+  if (one_hot && y_train.size() > 0) {
+    oneHotEncoding(y_one_hot, y_train, y_train.maxCoeff() + 1);
+  }
+  const Eigen::MatrixXf &labels = one_hot ? y_one_hot : y_train;
+
+  // Every epoch gathers the train set, in a new shuffled order, into
+  // contiguous batches that steps hand the model as they are: one more copy
+  // of the train set, allocated once and rewritten each epoch.
+  const uint32_t local_batch_num = (rows + batch_size - 1) / batch_size;
+  std::vector<Eigen::MatrixXf> X_batches(local_batch_num);
+  std::vector<Eigen::MatrixXf> y_batches(local_batch_num);
+  for (uint32_t b = 0; b < local_batch_num; b++) {
+    const uint32_t size = std::min(batch_size, rows - b * batch_size);
+    X_batches[b].resize(size, X_train.cols());
+    y_batches[b].resize(size, labels.cols());
+  }
+  Eigen::MatrixXf y_pred;
+  Evaluator evaluator;
+  EpochReport report;
+
+  // the same orders on every rank unless each rank holds its own shard of
+  // the samples
+  const uint32_t shuffle_index = globalParallelismMode() == DATA_PARALLELISM
+                                     ? globalController().mpiRank()
+                                     : 0;
+  std::vector<int64_t> order;
+
   for (uint32_t i = 0; i < epochs; i++) {
     float loss = 0.f;
+    size_t max_step_allocations = 0;
+    randomPermutation(order, rows, {SHUFFLE_RANDOM, shuffle_index, i});
+    gatherBatches(X_batches, X_train, order);
+    gatherBatches(y_batches, labels, order);
+    auto epoch_start = std::chrono::steady_clock::now();
     for (uint32_t batch_idx = 0; batch_idx < batch_num; batch_idx++) {
       float batch_loss = 0.f;
       globalTrainStatus().setStatus(i, batch_idx);
-      Eigen::MatrixXf X_batch =
-          X_train.block<batch_size, feature_dim>(batch_idx * batch_size, 0);
-      Eigen::MatrixXf y_batch =
-          y_train.block<batch_size, 1>(batch_idx * batch_size, 0);
-      y_batch = oneHotEncoding(y_batch);
+      size_t allocations = allocationCount();
 
-      model.forward(X_batch);
-      model.backward(batch_loss, y_batch, X_batch);
+      const Eigen::MatrixXf &X_batch = X_batches[batch_idx];
+      model.forward(y_pred, X_batch);
+      model.backward(batch_loss, y_batches[batch_idx], y_pred);
       loss += batch_loss;
-    }
 
-    addAccuracy(train_acc, model, y_train, X_train);
-    addAccuracy(test_acc, model, y_test, X_test);
-
-    loss /= batch_num;
+      // the first step sizes the workspace, and the first one after a
+      // smaller last batch resizes it back
+      if (batch_idx > 0 && X_batch.rows() == batch_size) {
+        max_step_allocations = std::max(max_step_allocations,
+                                        allocationCount() - allocations);
+      }
+    }
+    // apply a partial accumulation window before evaluating
+    model.flushGradients();
+    std::chrono::duration<double, std::milli> epoch_time =
+        std::chrono::steady_clock::now() - epoch_start;
 
-    if (i % step == 0)
-      Log() << "Epoch: " << i << ", train accuracy: " << train_acc.at(i)
-            << ", loss: " << loss << ", test accuracy: " << test_acc.at(i);
+    // the previous round ran in the background during this epoch
+    if (evaluator.isPending()) {
+      reportEpoch(evaluator, report, train_acc, test_acc, step);
+    }
+    evaluator.snapshot(model);
+    evaluator.evaluate(y_train, X_train);
+    evaluator.evaluate(y_test, X_test);
+    report = {i, loss / batch_num, epoch_time.count(), max_step_allocations};
+    if (!evaluator.isAsync()) {
+      reportEpoch(evaluator, report, train_acc, test_acc, step);
+    }
+  }
+  if (evaluator.isPending()) {
+    reportEpoch(evaluator, report, train_acc, test_acc, step);
   }
 }
@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Tests of gradient accumulation: K micro-batches make the same update as
+ * one batch of K times their size, and leave the weights alone until then
+ */
+
+#include "Common.hpp"
+#include "Identity.hpp"
+#include "Linear.hpp"
+#include "MSE.hpp"
+#include "ReLU.hpp"
+#include "Random.hpp"
+#include "Sequential.hpp"
+#include "Test.hpp"
+
+using namespace DeepLearningFramework;
+
+namespace {
+const std::vector<int> kLayersSize = {4, 8, 3};
+const Eigen::Index kBatch = 8;
+const int kMicroSteps = 4;
+
+std::vector<Eigen::MatrixXf> parameters() {
+  std::vector<Eigen::MatrixXf> values;
+  for (size_t i = 0; i + 1 < kLayersSize.size(); i++) {
+    values.push_back(globalState().getWeights(i));
+    values.push_back(globalState().getBias(i));
+  }
+  return values;
+}
+
+void setParameters(const std::vector<Eigen::MatrixXf> &values) {
+  for (size_t i = 0; i + 1 < kLayersSize.size(); i++) {
+    globalState().getWeights(i) = values[2 * i];
+    globalState().getBias(i) = values[2 * i + 1];
+  }
+}
+
+bool sameParameters(const std::vector<Eigen::MatrixXf> &a,
+                    const std::vector<Eigen::MatrixXf> &b, float tolerance) {
+  for (size_t i = 0; i < a.size(); i++) {
+    if (!a[i].isApprox(b[i], tolerance)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// With the same batch on every rank, the dout exchange of plain data
+// parallelism and the parameter gradient exchange of accumulation agree.
+void testAccumulation(Sequential &model) {
+  const Eigen::MatrixXf x =
+      randomMatrix(kBatch, kLayersSize.front(), {WEIGHTS_RANDOM, 100, 0});
+  const Eigen::MatrixXf y =
+      randomMatrix(kBatch, kLayersSize.back(), {WEIGHTS_RANDOM, 101, 0});
+  const std::vector<Eigen::MatrixXf> initial = parameters();
+  Eigen::MatrixXf y_pred;
+  float loss;
+
+  // one update on the whole batch
+  model.setGradientAccumulation(1);
+  model.forward(y_pred, x);
+  model.backward(loss, y, y_pred);
+  const std::vector<Eigen::MatrixXf> whole = parameters();
+  CHECK(!sameParameters(whole, initial, 1e-6f));
+
+  // the same update from kMicroSteps slices of it
+  setParameters(initial);
+  model.setGradientAccumulation(kMicroSteps);
+  const Eigen::Index rows = kBatch / kMicroSteps;
+  for (int step = 0; step < kMicroSteps; step++) {
+    CHECK(sameParameters(parameters(), initial, 0.f));
+    const Eigen::MatrixXf x_micro = x.middleRows(step * rows, rows);
+    model.forward(y_pred, x_micro);
+    model.backward(loss, y.middleRows(step * rows, rows), y_pred);
+  }
+  CHECK(sameParameters(parameters(), whole, 1e-5f));
+
+  // a partial window is applied by flushGradients, scaled by its length
+  setParameters(initial);
+  for (int step = 0; step < 2; step++) {
+    const Eigen::MatrixXf x_micro = x.middleRows(step * rows, rows);
+    model.forward(y_pred, x_micro);
+    model.backward(loss, y.middleRows(step * rows, rows), y_pred);
+  }
+  CHECK(sameParameters(parameters(), initial, 0.f));
+  model.flushGradients();
+  CHECK(!sameParameters(parameters(), initial, 1e-6f));
+}
+} // namespace
+
+int main() {
+  globalParallelismMode() = DATA_PARALLELISM;
+  globalTrainMode() = SYNC;
+  initialize(kLayersSize);
+
+  std::vector<Module *> layers = {
+      new Layers::Linear(kLayersSize[0], kLayersSize[1]),
+      new Activations::ReLU(),
+      new Layers::Linear(kLayersSize[1], kLayersSize[2]),
+      new Activations::Identity()};
+  Losses::MSE loss;
+  Sequential model(layers, loss);
+  model.setLR(0.1f);
+  testAccumulation(model);
+  return 0;
+}
@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Tests of the BackgroundThread task ring: tasks run once each, in the order
+ * they were posted, across many laps of the ring and from several producers,
+ * on a tensor the caller may overwrite at once
+ */
+
+#include "Test.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace DeepLearningFramework;
+
+namespace {
+// many more tasks than slots, so producers wait on a full ring
+const int kLaps = 50;
+const int kTaskCount = static_cast<int>(BackgroundThread::kTasks) * kLaps;
+
+// tasks run in the order one producer posted them
+void testOrder() {
+  BackgroundThread thread;
+  std::vector<int> order;
+  for (int i = 0; i < kTaskCount; i++) {
+    thread.post([&order, i]() { order.push_back(i); });
+  }
+  thread.run([]() {});
+  CHECK(static_cast<int>(order.size()) == kTaskCount);
+  for (int i = 0; i < kTaskCount; i++) {
+    CHECK(order[i] == i);
+  }
+}
+
+// each producer's tasks run once each, in its order; the worker records
+// the checks, since only the main thread may abort MPI
+void testProducers() {
+  const int producers = 4;
+  BackgroundThread thread;
+  std::vector<int> next(producers, 0);
+  int out_of_order = 0;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&thread, &next, &out_of_order, p]() {
+      for (int i = 0; i < kTaskCount; i++) {
+        thread.post([&next, &out_of_order, p, i]() {
+          out_of_order += next[p] != i;
+          next[p] = i + 1;
+        });
+      }
+    });
+  }
+  for (std::thread &producer : threads) {
+    producer.join();
+  }
+  thread.run([]() {});
+  CHECK(out_of_order == 0);
+  for (int p = 0; p < producers; p++) {
+    CHECK(next[p] == kTaskCount);
+  }
+}
+
+// the task sees the tensor as it was posted, whatever its size and however
+// the slot's buffer was sized by an earlier lap
+void testTensor() {
+  BackgroundThread thread;
+  std::vector<float> sums(kTaskCount);
+  int wrong_shape = 0;
+  Eigen::MatrixXf tensor;
+  for (int i = 0; i < kTaskCount; i++) {
+    const Eigen::Index rows = 1 + i % 7, cols = 1 + (i / 7) % 5;
+    tensor = Eigen::MatrixXf::Constant(rows, cols, static_cast<float>(i));
+    thread.post(
+        [&sums, &wrong_shape, i, rows, cols](Eigen::MatrixXf::MapType t) {
+          wrong_shape += t.rows() != rows || t.cols() != cols;
+          sums[i] = t.sum();
+        },
+        tensor);
+    // the caller reuses its tensor at once
+    tensor.setConstant(-1.f);
+  }
+  thread.run([]() {});
+  CHECK(wrong_shape == 0);
+  for (int i = 0; i < kTaskCount; i++) {
+    const int size = (1 + i % 7) * (1 + (i / 7) % 5);
+    CHECK(sums[i] == static_cast<float>(i) * size);
+  }
+}
+
+// run() returns after its task, and the destructor runs every task posted
+// before it
+void testWaits() {
+  std::atomic<int> count(0);
+  {
+    BackgroundThread thread;
+    int value = 0;
+    thread.run([&value]() { value = 42; });
+    CHECK(value == 42);
+
+    for (int i = 0; i < kTaskCount; i++) {
+      thread.post([&count]() { count.fetch_add(1); });
+    }
+  }
+  CHECK(count.load() == kTaskCount);
+}
+} // namespace
+
+int main() {
+  // initializes MPI
+  globalController();
+  testOrder();
+  testProducers();
+  testTensor();
+  testWaits();
+  return 0;
+}
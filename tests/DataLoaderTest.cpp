@@ -0,0 +1,387 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Tests of the dataset loaders: CSV and binary parts give the same shards,
+ * the shards and every shuffled pass cover each sample once across ranks,
+ * the CSV parser gives the floats strtof gives, and a missing or invalid part
+ * fails the whole load
+ */
+
+#include "Common.hpp"
+#include "DataLoader.hpp"
+#include "Test.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace DeepLearningFramework;
+
+namespace {
+const std::string kCsvPath = "DataLoaderTest_csv/";
+const std::string kBinaryPath = "DataLoaderTest_binary/";
+const std::string kGapPath = "DataLoaderTest_gap/";
+const std::string kParserPath = "DataLoaderTest_parser/";
+const std::string kTokenPath = "DataLoaderTest_token/";
+const std::string kShardCsvPath = "DataLoaderTest_shard_csv/";
+const std::string kShardBinaryPath = "DataLoaderTest_shard_binary/";
+// rows of the train parts of the sharding dataset, which no rank count of 3
+// or 4 divides
+const int kShardPartRows[] = {9, 5};
+// rows of the train parts, the empty one included
+const int kPartRows[] = {5, 0, 7};
+const int kCols = 3;
+
+float feature(int row, int col) { return row * 10.f + col + 0.25f; }
+
+float label(int row) { return row % 3; }
+
+// rank 0 writes the CSV dataset: rows numbered across the train parts,
+// one test part
+void writeCsvPart(const std::string &dir, const std::string &name,
+                  int first_row, int rows, bool labels) {
+  mkdir(dir.c_str(), 0755);
+  std::ofstream file(dir + name);
+  for (int r = first_row; r < first_row + rows; r++) {
+    if (labels) {
+      file << label(r) << "\n";
+      continue;
+    }
+    for (int c = 0; c < kCols; c++) {
+      file << feature(r, c) << (c + 1 < kCols ? "," : "\n");
+    }
+  }
+}
+
+void writeDatasets() {
+  if (globalController().mpiRank() == 0) {
+    mkdir(kCsvPath.c_str(), 0755);
+    int first_row = 0;
+    for (int i = 0; i < 3; i++) {
+      const std::string name = "part-" + formatString(i);
+      writeCsvPart(kCsvPath + "train_features/", name, first_row,
+                   kPartRows[i], false);
+      writeCsvPart(kCsvPath + "train_labels/", name, first_row, kPartRows[i],
+                   true);
+      first_row += kPartRows[i];
+    }
+    writeCsvPart(kCsvPath + "test_features/", "part-00000", 0, 6, false);
+    writeCsvPart(kCsvPath + "test_labels/", "part-00000", 0, 6, true);
+
+    mkdir(kShardCsvPath.c_str(), 0755);
+    int shard_row = 0;
+    for (int i = 0; i < 2; i++) {
+      const std::string name = "part-" + formatString(i);
+      writeCsvPart(kShardCsvPath + "train_features/", name, shard_row,
+                   kShardPartRows[i], false);
+      writeCsvPart(kShardCsvPath + "train_labels/", name, shard_row,
+                   kShardPartRows[i], true);
+      shard_row += kShardPartRows[i];
+    }
+    writeCsvPart(kShardCsvPath + "test_features/", "part-00000", 0, 5, false);
+    writeCsvPart(kShardCsvPath + "test_labels/", "part-00000", 0, 5, true);
+
+    // part-00001 missing
+    mkdir(kGapPath.c_str(), 0755);
+    for (int i : {0, 2}) {
+      const std::string name = "part-" + formatString(i);
+      writeCsvPart(kGapPath + "train_features/", name, 0, 4, false);
+      writeCsvPart(kGapPath + "train_labels/", name, 0, 4, true);
+    }
+  }
+  globalController().mpiBarrier();
+}
+
+// rank 0 writes a train split of one part
+void writeTrainPart(const std::string &path, const std::string &features,
+                    Eigen::Index rows) {
+  // no rank still maps the previous part
+  globalController().mpiBarrier();
+  if (globalController().mpiRank() == 0) {
+    mkdir(path.c_str(), 0755);
+    mkdir((path + "train_features/").c_str(), 0755);
+    std::ofstream(path + "train_features/part-00000") << features;
+    writeCsvPart(path + "train_labels/", "part-00000", 0, rows, true);
+  }
+  globalController().mpiBarrier();
+}
+
+// "-1.25e-3"-like tokens with up to 25 digits and exponents up to +-60,
+// most of which the parser cannot scale exactly
+std::string randomToken(std::mt19937 &generator) {
+  std::uniform_int_distribution<int> digit(0, 9), length(1, 25),
+      exponent(-60, 60), coin(0, 3);
+  std::string token = coin(generator) == 0 ? "-" : "";
+  const int digits = length(generator);
+  const int point = std::uniform_int_distribution<int>(0, digits)(generator);
+  for (int i = 0; i < digits; i++) {
+    token += i == point ? "." : "";
+    token += static_cast<char>('0' + digit(generator));
+  }
+  if (coin(generator) != 0) {
+    token += "e" + std::to_string(exponent(generator));
+  }
+  return token;
+}
+
+// this rank's rows [begin, begin + rows) of the split
+void checkShard(const Eigen::MatrixXf &X, const Eigen::MatrixXf &y,
+                Eigen::Index total_rows) {
+  const Eigen::Index rows = total_rows / globalController().mpiSize();
+  const Eigen::Index begin = rows * globalController().mpiRank();
+  CHECK(X.rows() == rows && X.cols() == kCols);
+  CHECK(y.rows() == rows && y.cols() == 1);
+  for (Eigen::Index r = 0; r < rows; r++) {
+    for (int c = 0; c < kCols; c++) {
+      CHECK(Tests::near(X(r, c), feature(begin + r, c), 1e-6));
+    }
+    CHECK(y(r, 0) == label(begin + r));
+  }
+}
+
+void testCsvAndBinary() {
+  Eigen::MatrixXf X_train, y_train, X_test, y_test;
+  DataLoader::load(kCsvPath, X_train, y_train, X_test, y_test);
+  checkShard(X_train, y_train, 12);
+  checkShard(X_test, y_test, 6);
+
+  CHECK(DataLoader::convert(kCsvPath, kBinaryPath));
+  Eigen::MatrixXf X_binary, y_binary, X_test_binary, y_test_binary;
+  DataLoader::load(kBinaryPath, X_binary, y_binary, X_test_binary,
+                   y_test_binary);
+  CHECK(X_binary == X_train && y_binary == y_train);
+  CHECK(X_test_binary == X_test && y_test_binary == y_test);
+
+  // in order, the stream reads the same shard
+  BatchStream stream(kCsvPath, "train", 2, true, false);
+  CHECK(stream.rows() == X_train.rows());
+  CHECK(stream.classes() == 3);
+  Eigen::Index row = 0;
+  for (const BatchStream::Batch &batch : stream) {
+    CHECK(batch.features == X_train.middleRows(row, 2));
+    CHECK(batch.labels == y_train.middleRows(row, 2));
+    row += 2;
+  }
+  CHECK(row == stream.batchCount() * 2);
+}
+
+void testTruncatedBinaryPart() {
+  if (globalController().mpiRank() == 0) {
+    const std::string part = kBinaryPath + "train_features/part-00002";
+    CHECK(truncate(part.c_str(), kDatasetPartAlignment + 8) == 0);
+  }
+  globalController().mpiBarrier();
+  Eigen::MatrixXf X_train, y_train, X_test, y_test;
+  DataLoader::load(kBinaryPath, X_train, y_train, X_test, y_test);
+  CHECK(X_train.size() == 0);
+  // the other matrices still load
+  checkShard(X_test, y_test, 6);
+  CHECK(y_train.rows() == 12 / globalController().mpiSize());
+
+  BatchStream stream(kBinaryPath, "train", 2);
+  CHECK(stream.rows() == 0 && stream.batchCount() == 0);
+}
+
+void testMissingPart() {
+  Eigen::MatrixXf X_train, y_train, X_test, y_test;
+  DataLoader::load(kGapPath, X_train, y_train, X_test, y_test);
+  CHECK(X_train.size() == 0 && y_train.size() == 0);
+  CHECK(X_test.size() == 0 && y_test.size() == 0);
+
+  BatchStream stream(kGapPath, "train", 2);
+  CHECK(stream.rows() == 0 && stream.batchCount() == 0);
+  for (const BatchStream::Batch &batch : stream) {
+    CHECK(batch.features.size() < 0);
+  }
+}
+
+// the sample a feature row was written from
+Eigen::Index sampleOf(const Eigen::MatrixXf &features, Eigen::Index row) {
+  return static_cast<Eigen::Index>(std::lround((features(row, 0) - 0.25f) /
+                                               10.f));
+}
+
+// how many times each sample was seen by all ranks together
+std::vector<int> sumCounts(std::vector<int> counts) {
+  std::vector<int> total(counts.size());
+  globalController().mpiAllreduce(counts.data(), total.data(),
+                                  static_cast<int>(counts.size()), MPI_SUM);
+  return total;
+}
+
+// every rank holds the same number of samples, and together the ranks hold
+// each of total_rows / size * size samples once, the leftover none
+void checkCoverage(const std::vector<int> &counts, Eigen::Index rows,
+                   Eigen::Index total_rows) {
+  const Eigen::Index shard = total_rows / globalController().mpiSize();
+  CHECK(rows == shard);
+  const std::vector<int> total = sumCounts(counts);
+  Eigen::Index covered = 0;
+  for (int count : total) {
+    CHECK(count == 0 || count == 1);
+    covered += count;
+  }
+  CHECK(covered == shard * globalController().mpiSize());
+}
+
+void testSharding(const std::string &path) {
+  const Eigen::Index total_rows = kShardPartRows[0] + kShardPartRows[1];
+  Eigen::MatrixXf X_train, y_train, X_test, y_test;
+  DataLoader::load(path, X_train, y_train, X_test, y_test);
+  // contiguous shards of the first rows, across the part boundary
+  checkShard(X_train, y_train, total_rows);
+  checkShard(X_test, y_test, 5);
+
+  BatchStream stream(path, "train", 3, false, true);
+  CHECK(stream.rows() == total_rows / globalController().mpiSize());
+  std::vector<std::vector<Eigen::Index>> orders;
+  for (int pass = 0; pass < 3; pass++) {
+    std::vector<int> counts(total_rows);
+    std::vector<Eigen::Index> order;
+    for (const BatchStream::Batch &batch : stream) {
+      CHECK(batch.features.rows() == batch.labels.rows());
+      for (Eigen::Index r = 0; r < batch.features.rows(); r++) {
+        const Eigen::Index sample = sampleOf(batch.features, r);
+        CHECK(sample >= 0 && sample < total_rows);
+        CHECK(batch.labels(r, 0) == label(sample));
+        counts[sample]++;
+        order.push_back(sample);
+      }
+    }
+    checkCoverage(counts, static_cast<Eigen::Index>(order.size()),
+                  total_rows);
+    orders.push_back(order);
+  }
+  // a new order every pass, the same on every rank: the shards still
+  // partition the samples, checked above
+  CHECK(orders[0] != orders[1] || orders[1] != orders[2]);
+}
+
+// every value is the float strtof gives, bit for bit
+void testParser() {
+  std::vector<std::string> tokens = {
+      // exact, and halfway between two floats
+      "0", "-0", "+2.5", ".5", "5.", "1E5", "16777217", "16777219",
+      "0.1", "3.4028234663852886e38", "1.00000005960464477539",
+      "1.000000059604644775390625", "1.0000000596046447753906251",
+      // beyond the powers of ten a double holds exactly
+      "1e23", "4.7e-23", "123456789012345678901234", "1e-30", "9e40",
+      "-1e-50",
+      // subnormal floats
+      "1e-45", "1.4e-45", "7e-46", "1.17549435e-38", "5.8774718e-39"};
+  std::mt19937 generator(7);
+  // printed doubles at and next to halfway between two floats
+  std::uniform_real_distribution<float> uniform(-1e6f, 1e6f);
+  for (int i = 0; i < 500; i++) {
+    const float below = uniform(generator);
+    const double halfway =
+        (double(below) + std::nextafter(below, 2e6f)) / 2;
+    for (double value : {halfway, std::nextafter(halfway, -1e7),
+                         std::nextafter(halfway, 1e7)}) {
+      char token[32];
+      std::snprintf(token, sizeof(token), "%.17g", value);
+      tokens.push_back(token);
+    }
+  }
+  const int cols = 4;
+  while (tokens.size() % cols != 0 || tokens.size() < 6000) {
+    tokens.push_back(randomToken(generator));
+  }
+  const Eigen::Index rows = tokens.size() / cols;
+  // blank lines before the first row do not hide its columns
+  std::ostringstream text;
+  text << "\n  \n\r\n";
+  for (size_t i = 0; i < tokens.size(); i++) {
+    text << tokens[i] << ((i + 1) % cols == 0 ? "\n" : ",");
+  }
+  writeTrainPart(kParserPath, text.str(), rows);
+
+  Eigen::MatrixXf X_train, y_train, X_test, y_test;
+  DataLoader::load(kParserPath, X_train, y_train, X_test, y_test);
+  const Eigen::Index shard = rows / globalController().mpiSize();
+  const Eigen::Index begin = shard * globalController().mpiRank();
+  CHECK(X_train.rows() == shard && X_train.cols() == cols);
+  for (Eigen::Index r = 0; r < shard; r++) {
+    for (int c = 0; c < cols; c++) {
+      const float expected =
+          std::strtof(tokens[(begin + r) * cols + c].c_str(), nullptr);
+      const float parsed = X_train(r, c);
+      CHECK(std::memcmp(&parsed, &expected, sizeof(float)) == 0);
+    }
+  }
+}
+
+// a token that is not a number fails the load on every rank, even if only
+// the shard of the last rank holds it
+void testNonNumericToken() {
+  const char *bad_tokens[] = {"abc", "1e", "1.2.3", "--1", "0x10", "nan"};
+  for (const char *bad_token : bad_tokens) {
+    std::ostringstream text;
+    const int rows = 6;
+    // the last row of the last shard, not the dropped leftover
+    const int bad_row = rows / globalController().mpiSize() *
+                            globalController().mpiSize() -
+                        1;
+    for (int r = 0; r < rows; r++) {
+      text << r << ",1.5," << (r == bad_row ? bad_token : "2") << "\n";
+    }
+    writeTrainPart(kTokenPath, text.str(), rows);
+    Eigen::MatrixXf X_train, y_train, X_test, y_test;
+    DataLoader::load(kTokenPath, X_train, y_train, X_test, y_test);
+    CHECK(X_train.size() == 0);
+    CHECK(y_train.rows() == rows / globalController().mpiSize());
+
+    BatchStream stream(kTokenPath, "train", 1, true, false);
+    Eigen::Index batches = 0;
+    for (const BatchStream::Batch &batch : stream) {
+      CHECK(batch.features.rows() == 1);
+      batches++;
+    }
+    // the stream stops at the row it cannot parse
+    if (globalController().mpiRank() == globalController().mpiSize() - 1) {
+      CHECK(batches == stream.batchCount() - 1);
+    }
+  }
+}
+} // namespace
+
+int main() {
+  // initializes MPI
+  globalController();
+  globalParallelismMode() = DATA_PARALLELISM;
+  writeDatasets();
+  testCsvAndBinary();
+  testTruncatedBinaryPart();
+  testMissingPart();
+  CHECK(DataLoader::convert(kShardCsvPath, kShardBinaryPath));
+  testSharding(kShardCsvPath);
+  testSharding(kShardBinaryPath);
+  testParser();
+  testNonNumericToken();
+  return 0;
+}
@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Tests of the hand-written GEMM kernels against exact products, on shapes
+ * that leave every kind of remainder to the vector loops
+ */
+
+#include "Gemm.hpp"
+#include "Random.hpp"
+#include "Test.hpp"
+
+#include <limits>
+
+using namespace DeepLearningFramework;
+
+namespace {
+const Eigen::Index kRows[] = {1, 2, 3, 7, 16, 17, 40};
+const Eigen::Index kCols[] = {1, 3, 4, 5, 9, 17};
+const Eigen::Index kInner[] = {1, 31, 32, 33, 100};
+
+// c = a * b, or c0 + a * b, in fp32 sums of exact bf16 products: within a
+// few fp32 roundings of the sum of |products|
+void checkBf16(const Eigen::MatrixXf &c, const Eigen::MatrixXf &c0,
+               const RowMajorMatrixXbf16 &a, const MatrixXbf16 &b) {
+  const Eigen::MatrixXd a_exact = a.cast<float>().cast<double>();
+  const Eigen::MatrixXd b_exact = b.cast<float>().cast<double>();
+  const Eigen::MatrixXd exact = c0.cast<double>() + a_exact * b_exact;
+  const Eigen::MatrixXd bound =
+      c0.cast<double>().cwiseAbs() + a_exact.cwiseAbs() * b_exact.cwiseAbs();
+  CHECK(c.rows() == exact.rows() && c.cols() == exact.cols());
+  for (Eigen::Index i = 0; i < c.size(); i++) {
+    CHECK(std::abs(c.data()[i] - exact.data()[i]) <=
+          1e-6 * (a.cols() + 1) * bound.data()[i]);
+  }
+}
+
+void testGemmBf16() {
+  uint32_t seed = 0;
+  for (Eigen::Index m : kRows) {
+    for (Eigen::Index n : kCols) {
+      for (Eigen::Index k : kInner) {
+        seed++;
+        const RowMajorMatrixXbf16 a =
+            randomMatrix(m, k, {WEIGHTS_RANDOM, seed, 0}, -4.f, 4.f)
+                .cast<Eigen::bfloat16>();
+        const MatrixXbf16 b = randomMatrix(k, n, {WEIGHTS_RANDOM, seed, 1})
+                                  .cast<Eigen::bfloat16>();
+        Eigen::MatrixXf c;
+        gemmBf16(c, a, b);
+        checkBf16(c, Eigen::MatrixXf::Zero(m, n), a, b);
+
+        const Eigen::MatrixXf c0 =
+            randomMatrix(m, n, {WEIGHTS_RANDOM, seed, 2});
+        c = c0;
+        gemmBf16(c, a, b, true);
+        checkBf16(c, c0, a, b);
+
+        // the row-major view of the transpose of a column-major matrix
+        const MatrixXbf16 a_transpose = a.transpose();
+        gemmBf16(c, Eigen::Map<const RowMajorMatrixXbf16>(a_transpose.data(),
+                                                          m, k),
+                 b);
+        checkBf16(c, Eigen::MatrixXf::Zero(m, n), a, b);
+
+        // columns of b apart in memory, with NaNs in between that the
+        // kernel must not read
+        MatrixXbf16 padded = MatrixXbf16::Constant(
+            k + 1, n, Eigen::bfloat16(std::numeric_limits<float>::quiet_NaN()));
+        padded.topRows(k) = b;
+        gemmBf16(c, a,
+                 Eigen::Map<const MatrixXbf16, 0, Eigen::OuterStride<>>(
+                     padded.data(), k, n, Eigen::OuterStride<>(k + 1)));
+        checkBf16(c, Eigen::MatrixXf::Zero(m, n), a, b);
+      }
+    }
+  }
+}
+
+const Eigen::Index kInt8Inner[] = {1, 15, 16, 17, 31, 32, 33, 100};
+
+RowMajorMatrixXi8 randomInt8(Eigen::Index rows, Eigen::Index cols,
+                             uint32_t seed) {
+  return randomMatrix(rows, cols, {WEIGHTS_RANDOM, seed, 4}, -128.f, 127.f)
+      .array()
+      .round()
+      .cast<int8_t>();
+}
+
+// exact int32 products, on every kernel the CPU runs and on k that leaves
+// remainders to the 16- and 32-value steps. -128 is the value the VNNI
+// kernel's unsigned offset has to get right.
+void testGemmInt8() {
+  const Int8Isa best = int8Isa();
+  for (Int8Isa isa : {INT8_EIGEN, INT8_AVX2, INT8_AVX_VNNI}) {
+    if (!int8IsaSupported(isa)) {
+      continue;
+    }
+    int8Isa() = isa;
+    uint32_t seed = 0;
+    for (Eigen::Index m : kRows) {
+      for (Eigen::Index n : kCols) {
+        for (Eigen::Index k : kInt8Inner) {
+          seed++;
+          RowMajorMatrixXi8 a = randomInt8(m, k, 2 * seed);
+          MatrixXi8 b = randomInt8(k, n, 2 * seed + 1);
+          a(0, k - 1) = -128;
+          b(k - 1, 0) = -128;
+          Eigen::MatrixXi c;
+          gemmInt8(c, a, b);
+          CHECK(c == a.cast<int>() * b.cast<int>());
+
+          // the largest sums, of -128 * -128 and of -128 * 127
+          a.setConstant(-128);
+          b.setConstant(-128);
+          b.col(n - 1).setConstant(127);
+          gemmInt8(c, a, b);
+          CHECK(c == a.cast<int>() * b.cast<int>());
+        }
+      }
+    }
+  }
+  int8Isa() = best;
+}
+
+// normal values round the same as Eigen's cast
+void testCastBf16() {
+  for (Eigen::Index rows : kInner) {
+    for (Eigen::Index cols : kRows) {
+      const Eigen::MatrixXf src = randomMatrix(
+          rows, cols, {WEIGHTS_RANDOM, static_cast<uint32_t>(rows), 3}, -4.f,
+          4.f);
+      MatrixXbf16 dst;
+      castBf16(dst, src);
+      CHECK(dst.rows() == rows && dst.cols() == cols);
+      const MatrixXbf16 expected = src.cast<Eigen::bfloat16>();
+      for (Eigen::Index i = 0; i < src.size(); i++) {
+        CHECK(dst.data()[i].value == expected.data()[i].value);
+      }
+    }
+  }
+}
+} // namespace
+
+int main() {
+  // initializes MPI
+  globalController();
+  testGemmBf16();
+  testCastBf16();
+  testGemmInt8();
+  return 0;
+}
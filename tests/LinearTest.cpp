@@ -0,0 +1,303 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Tests of the Linear layers: their gradients against central finite
+ * differences, FixedLinear computes what Linear computes on the batches it
+ * is specialized for, and the bf16 GEMMs of MIXED_BF16 stay close to fp32
+ */
+
+#include "Common.hpp"
+#include "FixedLinear.hpp"
+#include "Gemm.hpp"
+#include "Linear.hpp"
+#include "Random.hpp"
+#include "SparseLinear.hpp"
+#include "Test.hpp"
+
+using namespace DeepLearningFramework;
+
+namespace {
+// layer 0 and layer 2 have the same shape
+const std::vector<int> kLayersSize = {4, 8, 4, 8, 5};
+const Eigen::Index kBatch = 6;
+const double kTolerance = 1e-5;
+const float kStep = 1e-2f;
+const double kDerivativeTolerance = 1e-3;
+
+/**
+ * Loss sum(dout .* forward(x)), whose gradients are dout through backward:
+ * din, and the gradients of the weights and the bias, which the optimizers
+ * subtract.
+ */
+class Check {
+public:
+  Check(Module &layer, Eigen::Index rows, Eigen::Index in, Eigen::Index out,
+        uint32_t seed)
+      : _layer(layer) {
+    _x = randomMatrix(rows, in, {WEIGHTS_RANDOM, seed, 2});
+    // some features absent from the batch, for the sparse layer
+    _x.col(in - 1).setZero();
+    _dout = randomMatrix(rows, out, {WEIGHTS_RANDOM, seed, 3});
+    _layer.collectParameters(_parameters);
+    // a bias away from its initial value
+    Eigen::Map<Eigen::MatrixXf>(_parameters[1].value, 1, out) =
+        randomMatrix(1, out, {BIAS_RANDOM, seed, 0});
+  }
+
+  void run(bool check_din) {
+    Eigen::MatrixXf out, din;
+    _layer.accumulateGradients(false);
+    _layer.forward(out, _x);
+    _layer.backward(din, _dout);
+    for (Eigen::Index i = 0; check_din && i < _x.size(); i++) {
+      CHECK(Tests::near(din.data()[i], derivative(&_x.data()[i]),
+                        kDerivativeTolerance));
+    }
+    for (const Parameter &parameter : _parameters) {
+      if (parameter.sparse == nullptr) {
+        for (Eigen::Index i = 0; i < parameter.size; i++) {
+          CHECK(Tests::near(parameter.grad[i],
+                            derivative(&parameter.value[i]),
+                            kDerivativeTolerance));
+        }
+        continue;
+      }
+      // the rows of the features in the batch, each a row of the weights
+      const SparseGradient &gradient = *parameter.sparse;
+      const Eigen::Index width = gradient.width;
+      CHECK(static_cast<Eigen::Index>(gradient.rows.size()) ==
+            _x.cols() - 1);
+      for (size_t k = 0; k < gradient.rows.size(); k++) {
+        for (Eigen::Index col = 0; col < width; col++) {
+          float *value = parameter.value + gradient.rows[k] * width + col;
+          CHECK(Tests::near(gradient.values[k * width + col],
+                            derivative(value), kDerivativeTolerance));
+        }
+      }
+    }
+  }
+
+private:
+  double loss() {
+    Eigen::MatrixXf out;
+    _layer.forward(out, _x);
+    return (out.cast<double>().array() * _dout.cast<double>().array()).sum();
+  }
+
+  double derivative(float *value) {
+    const float saved = *value;
+    *value = saved + kStep;
+    const double plus = loss();
+    *value = saved - kStep;
+    const double minus = loss();
+    *value = saved;
+    return (plus - minus) / (2.0 * kStep);
+  }
+
+  Module &_layer;
+  Eigen::MatrixXf _x;
+  Eigen::MatrixXf _dout;
+  std::vector<Parameter> _parameters;
+};
+
+bool sameValues(const float *a, const float *b, Eigen::Index size) {
+  for (Eigen::Index i = 0; i < size; i++) {
+    if (!Tests::near(a[i], b[i], kTolerance)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool sameValues(const Eigen::MatrixXf &a, const Eigen::MatrixXf &b) {
+  return a.rows() == b.rows() && a.cols() == b.cols() &&
+         sameValues(a.data(), b.data(), a.size());
+}
+
+// the gradients of every parameter of a and b match
+bool sameGradients(Module &a, Module &b) {
+  std::vector<Parameter> a_parameters, b_parameters;
+  a.collectParameters(a_parameters);
+  b.collectParameters(b_parameters);
+  for (size_t p = 0; p < a_parameters.size(); p++) {
+    if (a_parameters[p].size != b_parameters[p].size ||
+        !sameValues(a_parameters[p].grad, b_parameters[p].grad,
+                    a_parameters[p].size)) {
+      return false;
+    }
+  }
+  return a_parameters.size() == b_parameters.size();
+}
+
+// outputs, input gradients and parameter gradients of FixedLinear match
+// Linear, overwritten and accumulated, on its batch size and on another
+void testFixedLinear(Layers::Linear &fixed, Layers::Linear &linear) {
+  const int in = kLayersSize[0], out = kLayersSize[1];
+  fixed.setWeightsAndBias(fixed.getWeights(),
+                          randomMatrix(1, out, {BIAS_RANDOM, 7, 0}));
+  linear.setWeightsAndBias(fixed.getWeights(), fixed.getBias());
+  for (Eigen::Index rows : {kBatch, kBatch - 1}) {
+    for (bool accumulate : {false, true}) {
+      const uint32_t seed = static_cast<uint32_t>(rows * 2 + accumulate);
+      const Eigen::MatrixXf x =
+          randomMatrix(rows, in, {WEIGHTS_RANDOM, seed, 0});
+      const Eigen::MatrixXf dout =
+          randomMatrix(rows, out, {WEIGHTS_RANDOM, seed, 1});
+      fixed.accumulateGradients(accumulate);
+      linear.accumulateGradients(accumulate);
+      Eigen::MatrixXf fixed_out, linear_out, fixed_din, linear_din;
+      fixed.forward(fixed_out, x);
+      linear.forward(linear_out, x);
+      CHECK(sameValues(fixed_out, linear_out));
+      fixed.backward(fixed_din, dout);
+      linear.backward(linear_din, dout);
+      CHECK(sameValues(fixed_din, linear_din));
+      CHECK(sameGradients(fixed, linear));
+    }
+  }
+}
+
+void testDerivatives(Layers::Linear &fixed, Layers::Linear &linear,
+                     Layers::Linear &sparse) {
+  const uint32_t rank = globalController().mpiRank();
+  Check(fixed, kBatch, kLayersSize[0], kLayersSize[1], rank).run(true);
+  Check(linear, kBatch - 1, kLayersSize[1], kLayersSize[2], rank).run(true);
+  // SparseLinear does not compute din
+  Check(sparse, kBatch, kLayersSize[3], kLayersSize[4], rank).run(false);
+}
+
+// |a - b| within tolerance of the largest |b|
+bool closeValues(const Eigen::MatrixXf &a, const Eigen::MatrixXf &b,
+                 float tolerance) {
+  return a.rows() == b.rows() && a.cols() == b.cols() &&
+         (a - b).cwiseAbs().maxCoeff() <= tolerance * b.cwiseAbs().maxCoeff();
+}
+
+struct Pass {
+  Eigen::MatrixXf out;
+  Eigen::MatrixXf din;
+  Eigen::MatrixXf weights_grad;
+  Eigen::MatrixXf bias_grad;
+};
+
+Pass runPass(Layers::Linear &layer, const Eigen::MatrixXf &x,
+             const Eigen::MatrixXf &dout) {
+  Pass pass;
+  layer.accumulateGradients(false);
+  layer.forward(pass.out, x);
+  layer.backward(pass.din, dout);
+  std::vector<Parameter> parameters;
+  layer.collectParameters(parameters);
+  pass.weights_grad =
+      Eigen::Map<Eigen::MatrixXf>(parameters[0].grad, x.cols(), dout.cols());
+  pass.bias_grad = Eigen::Map<Eigen::MatrixXf>(parameters[1].grad, 1,
+                                               dout.cols());
+  return pass;
+}
+
+// MIXED_BF16 matches fp32 to bf16 precision, and follows the weights once
+// told they changed
+void testBf16(Layers::Linear &layer) {
+  const int in = kLayersSize[1], out = kLayersSize[2];
+  const uint32_t seed = 100 + globalController().mpiRank();
+  const Eigen::MatrixXf x =
+      randomMatrix(kBatch, in, {WEIGHTS_RANDOM, seed, 4});
+  const Eigen::MatrixXf dout =
+      randomMatrix(kBatch, out, {WEIGHTS_RANDOM, seed, 5});
+  const float tolerance = 2e-2f;
+  for (int change = 0; change < 2; change++) {
+    if (change > 0) {
+      std::vector<Parameter> parameters;
+      layer.collectParameters(parameters);
+      Eigen::Map<Eigen::ArrayXf>(parameters[0].value, parameters[0].size) +=
+          0.5f;
+      layer.parametersChanged();
+    }
+    globalPrecisionMode() = FP32;
+    const Pass fp32 = runPass(layer, x, dout);
+    globalPrecisionMode() = MIXED_BF16;
+    const Pass bf16 = runPass(layer, x, dout);
+    globalPrecisionMode() = FP32;
+    CHECK(closeValues(bf16.out, fp32.out, tolerance));
+    CHECK(closeValues(bf16.din, fp32.din, tolerance));
+    CHECK(closeValues(bf16.weights_grad, fp32.weights_grad, tolerance));
+    CHECK(closeValues(bf16.bias_grad, fp32.bias_grad, 1e-6f));
+  }
+}
+
+// int8 predict stays within the rounding of its scaled inputs and weights
+// of fp32 predict, on every int8 kernel the CPU runs
+void testQuantized(Layers::Linear &layer) {
+  const int in = kLayersSize[1];
+  const Eigen::MatrixXf x =
+      randomMatrix(kBatch, in, {WEIGHTS_RANDOM, 200, 6}, -3.f, 3.f);
+  std::vector<Parameter> parameters;
+  layer.collectParameters(parameters);
+  const Eigen::MatrixXf weights = Eigen::Map<Eigen::MatrixXf>(
+      parameters[0].value, in, parameters[0].size / in);
+
+  // |x - s_x * round(x / s_x)| <= s_x / 2, and the same per column of w
+  const float x_scale = x.cwiseAbs().maxCoeff() / 127.f;
+  const Eigen::RowVectorXf w_scales =
+      weights.cwiseAbs().colwise().maxCoeff() / 127.f;
+  const Eigen::MatrixXf bound =
+      ((x.cwiseAbs().rowwise().sum() * w_scales / 2.f).rowwise() +
+       (weights.cwiseAbs().colwise().sum() * x_scale / 2.f +
+        in * x_scale * w_scales / 4.f))
+          .array() +
+      1e-5f;
+
+  Eigen::MatrixXf fp32;
+  layer.predict(fp32, x);
+  layer.quantize(x);
+  const Int8Isa best = int8Isa();
+  for (Int8Isa isa : {INT8_EIGEN, INT8_AVX2, INT8_AVX_VNNI}) {
+    if (!int8IsaSupported(isa)) {
+      continue;
+    }
+    int8Isa() = isa;
+    Eigen::MatrixXf int8;
+    layer.predict(int8, x);
+    CHECK(int8.rows() == fp32.rows() && int8.cols() == fp32.cols());
+    CHECK(((int8 - fp32).cwiseAbs().array() <= bound.array()).all());
+  }
+  int8Isa() = best;
+  layer.dequantize();
+}
+} // namespace
+
+int main() {
+  // initializes MPI
+  globalController();
+  globalParallelismMode() = DATA_PARALLELISM;
+  initialize(kLayersSize);
+  // layer ranks in order of construction
+  Layers::FixedLinear<kBatch, 4, 8> fixed;
+  Layers::Linear middle(kLayersSize[1], kLayersSize[2]);
+  Layers::Linear linear(kLayersSize[2], kLayersSize[3]);
+  Layers::SparseLinear sparse(kLayersSize[3], kLayersSize[4]);
+  testDerivatives(fixed, middle, sparse);
+  testFixedLinear(fixed, linear);
+  testBf16(middle);
+  testQuantized(middle);
+  return 0;
+}
@@ -0,0 +1,149 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Tests of the BatchNorm1d, SyncBatchNorm and LayerNorm gradients against
+ * central finite differences, on one rank and in data parallelism
+ */
+
+#include "BatchNorm.hpp"
+#include "LayerNorm.hpp"
+#include "Random.hpp"
+#include "Test.hpp"
+
+using namespace DeepLearningFramework;
+
+namespace {
+const Eigen::Index kBatch = 5;
+const int kFeatures = 4;
+const float kStep = 1e-2f;
+const double kTolerance = 5e-3;
+
+/**
+ * Loss sum(dout .* forward(x)), summed over the ranks in data parallelism,
+ * whose gradients are dout through backward: din w.r.t. the input of this
+ * rank, and the gradients of gamma and beta averaged over the ranks.
+ */
+class Check {
+public:
+  explicit Check(Module &layer) : _layer(layer) {
+    const uint32_t rank = globalController().mpiRank();
+    _x = randomMatrix(kBatch, kFeatures, {WEIGHTS_RANDOM, rank, 0}, -2.f, 2.f);
+    _dout = randomMatrix(kBatch, kFeatures, {BIAS_RANDOM, rank, 0});
+    _layer.collectParameters(_parameters);
+    // gamma and beta away from their initial values, the same on all ranks
+    for (size_t p = 0; p < _parameters.size(); p++) {
+      Eigen::Map<Eigen::MatrixXf>(_parameters[p].value, 1, kFeatures) =
+          randomMatrix(1, kFeatures, {EMBEDDING_RANDOM, uint32_t(p), 0},
+                       0.5f, 1.5f);
+    }
+  }
+
+  void run() {
+    Eigen::MatrixXf out, din;
+    _layer.forward(out, _x);
+    _layer.backward(din, _dout);
+    std::vector<Eigen::MatrixXf> grads;
+    for (const Parameter &parameter : _parameters) {
+      grads.push_back(
+          Eigen::Map<Eigen::MatrixXf>(parameter.grad, 1, kFeatures));
+    }
+
+    // each element of the input of each rank in turn, all ranks in step
+    const int rank = dataParallel() ? globalController().mpiRank() : 0;
+    const int ranks = dataParallel() ? globalController().mpiSize() : 1;
+    for (int owner = 0; owner < ranks; owner++) {
+      const bool mine = owner == rank;
+      for (Eigen::Index i = 0; i < _x.size(); i++) {
+        const double numeric = derivative(mine ? &_x.data()[i] : nullptr);
+        if (mine) {
+          CHECK(Tests::near(din.data()[i], numeric, kTolerance));
+        }
+      }
+    }
+    for (size_t p = 0; p < _parameters.size(); p++) {
+      for (int j = 0; j < kFeatures; j++) {
+        const double numeric =
+            derivative(&_parameters[p].value[j]) / ranks;
+        CHECK(Tests::near(grads[p](0, j), numeric, kTolerance));
+      }
+    }
+  }
+
+private:
+  bool dataParallel() const {
+    return globalParallelismMode() == DATA_PARALLELISM;
+  }
+
+  double loss() {
+    Eigen::MatrixXf out;
+    _layer.forward(out, _x);
+    double local =
+        (out.cast<double>().array() * _dout.cast<double>().array()).sum();
+    double total = local;
+    if (dataParallel()) {
+      MPI_Allreduce(&local, &total, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    }
+    return total;
+  }
+
+  // central difference of the loss in value, nullptr on the ranks that
+  // only take part in the collectives
+  double derivative(float *value) {
+    const float saved = value != nullptr ? *value : 0.f;
+    if (value != nullptr) {
+      *value = saved + kStep;
+    }
+    const double plus = loss();
+    if (value != nullptr) {
+      *value = saved - kStep;
+    }
+    const double minus = loss();
+    if (value != nullptr) {
+      *value = saved;
+    }
+    return (plus - minus) / (2.0 * kStep);
+  }
+
+  Module &_layer;
+  Eigen::MatrixXf _x;
+  Eigen::MatrixXf _dout;
+  std::vector<Parameter> _parameters;
+};
+
+void testNorms(ParallelismMode mode) {
+  globalParallelismMode() = mode;
+  Layers::BatchNorm1d batch_norm(kFeatures);
+  Check(batch_norm).run();
+  Layers::SyncBatchNorm sync_batch_norm(kFeatures);
+  Check(sync_batch_norm).run();
+  Layers::LayerNorm layer_norm(kFeatures);
+  Check(layer_norm).run();
+}
+} // namespace
+
+int main() {
+  // initializes MPI
+  globalController();
+  testNorms(TENSOR_MODEL_PARALLELISM);
+  testNorms(DATA_PARALLELISM);
+  return 0;
+}
@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Tests of the optimizers against their update rules, for dense and
+ * row-sparse parameters
+ */
+
+#include "AdamW.hpp"
+#include "SGD.hpp"
+#include "Test.hpp"
+
+#include <cmath>
+
+using namespace DeepLearningFramework;
+
+namespace {
+const int kSteps = 4;
+
+float gradient(int step, int i) { return std::sin(1.7f * step + 0.3f * i); }
+
+// Adam (weight_decay = 0) or AdamW on one element, in double
+struct AdamReference {
+  double value, m = 0, v = 0;
+  void step(int t, double lr, double grad, double weight_decay) {
+    const double beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+    value -= lr * weight_decay * value;
+    m = beta1 * m + (1 - beta1) * grad;
+    v = beta2 * v + (1 - beta2) * grad * grad;
+    value -= lr / (1 - std::pow(beta1, t)) * m /
+             (std::sqrt(v / (1 - std::pow(beta2, t))) + eps);
+  }
+};
+
+// momentum SGD with scaled gradients, and a learning rate changed midway
+void testSGD() {
+  std::vector<float> weights(7, 1.f), weights_grad(7);
+  std::vector<float> bias(3, -0.5f), bias_grad(3);
+  Optimizers::SGD sgd(0.1f, 0.9f);
+  sgd.setParameters(
+      {{weights.data(), weights_grad.data(), 7, true, nullptr, false},
+       {bias.data(), bias_grad.data(), 3, false, nullptr, false}});
+
+  std::vector<double> value(10), velocity(10, 0.0);
+  for (int i = 0; i < 10; i++) {
+    value[i] = i < 7 ? 1.0 : -0.5;
+  }
+  for (int t = 1; t <= kSteps; t++) {
+    if (t == 3) {
+      sgd.setLR(0.05f);
+    }
+    for (int i = 0; i < 10; i++) {
+      (i < 7 ? weights_grad[i] : bias_grad[i - 7]) = gradient(t, i);
+      velocity[i] = 0.9 * velocity[i] + 0.5 * gradient(t, i);
+      value[i] -= sgd.getLR() * velocity[i];
+    }
+    sgd.step(0.5f);
+  }
+  for (int i = 0; i < 10; i++) {
+    CHECK(Tests::near(i < 7 ? weights[i] : bias[i - 7], value[i], 1e-5));
+  }
+}
+
+// weight decay on the weights only
+void testAdamW() {
+  std::vector<float> weights(5, 0.8f), weights_grad(5);
+  std::vector<float> bias(2, 0.2f), bias_grad(2);
+  Optimizers::AdamW adamw(0.01f, 0.1f);
+  adamw.setParameters(
+      {{weights.data(), weights_grad.data(), 5, true, nullptr, false},
+       {bias.data(), bias_grad.data(), 2, false, nullptr, false}});
+
+  std::vector<AdamReference> reference(7);
+  for (int i = 0; i < 7; i++) {
+    reference[i].value = i < 5 ? 0.8 : 0.2;
+  }
+  for (int t = 1; t <= kSteps; t++) {
+    for (int i = 0; i < 7; i++) {
+      (i < 5 ? weights_grad[i] : bias_grad[i - 5]) = gradient(t, i);
+      reference[i].step(t, 0.01, gradient(t, i), i < 5 ? 0.1 : 0.0);
+    }
+    adamw.step();
+  }
+  for (int i = 0; i < 7; i++) {
+    CHECK(Tests::near(i < 5 ? weights[i] : bias[i - 5], reference[i].value,
+                      1e-5));
+  }
+}
+
+// only the rows of the gradient are updated, their state left untouched
+// in the steps they are absent from
+void testSparseRows() {
+  const int rows = 5, width = 3;
+  std::vector<float> table(rows * width, 1.f);
+  SparseGradient table_grad;
+  table_grad.width = width;
+  Optimizers::Adam adam(0.01f);
+  adam.setParameters(
+      {{table.data(), nullptr, rows * width, false, &table_grad, false}});
+
+  // row r is in the gradient of step t when (r + t) % 2 == 0, row 4 never
+  std::vector<AdamReference> reference(rows * width);
+  for (AdamReference &element : reference) {
+    element.value = 1.0;
+  }
+  for (int t = 1; t <= kSteps; t++) {
+    std::vector<int64_t> present;
+    for (int r = (t % 2); r < rows - 1; r += 2) {
+      present.push_back(r);
+    }
+    table_grad.addRows(present, false);
+    for (int64_t r : present) {
+      for (int c = 0; c < width; c++) {
+        table_grad.row(r)[c] = gradient(t, r * width + c);
+        // the bias corrections follow the global step
+        reference[r * width + c].step(t, 0.01, gradient(t, r * width + c),
+                                      0.0);
+      }
+    }
+    adam.step();
+  }
+  for (int i = 0; i < rows * width; i++) {
+    CHECK(Tests::near(table[i], reference[i].value, 1e-5));
+  }
+  for (int c = 0; c < width; c++) {
+    CHECK(table[(rows - 1) * width + c] == 1.f);
+  }
+}
+} // namespace
+
+int main() {
+  // initializes MPI
+  globalController();
+  testSGD();
+  testAdamW();
+  testSparseRows();
+  return 0;
+}
@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Tests of the counter-based random numbers and of the Dropout masks drawn
+ * from them
+ */
+
+#include "Dropout.hpp"
+#include "Random.hpp"
+#include "Test.hpp"
+
+#include <algorithm>
+
+using namespace DeepLearningFramework;
+
+namespace {
+// known answers of the Philox4x32-10 reference implementation (Random123)
+void testPhiloxKnownAnswers() {
+  const uint32_t counters[3][4] = {
+      {0, 0, 0, 0},
+      {0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu},
+      {0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}};
+  const uint32_t keys[3][2] = {
+      {0, 0}, {0xffffffffu, 0xffffffffu}, {0xa4093822u, 0x299f31d0u}};
+  const uint32_t expected[3][4] = {
+      {0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u},
+      {0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu},
+      {0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u}};
+  for (int t = 0; t < 3; t++) {
+    uint32_t out[4];
+    philox4x32(counters[t], keys[t], out);
+    CHECK(std::equal(out, out + 4, expected[t]));
+  }
+}
+
+// any range of blocks can be drawn on its own
+void testRandomBitsRanges() {
+  const RandomStream stream = {DROPOUT_RANDOM, 3, 7};
+  std::vector<uint32_t> all(4 * 100), part(4 * 30);
+  randomBits(stream, 0, 100, all.data());
+  randomBits(stream, 42, 30, part.data());
+  CHECK(std::equal(part.begin(), part.end(), all.begin() + 4 * 42));
+
+  // and a different step is a different sequence
+  const RandomStream next = {DROPOUT_RANDOM, 3, 8};
+  randomBits(next, 42, 30, part.data());
+  CHECK(!std::equal(part.begin(), part.end(), all.begin() + 4 * 42));
+}
+
+void testRandomPermutation() {
+  const int64_t n = 1000;
+  std::vector<int64_t> first, again, other;
+  randomPermutation(first, n, {SHUFFLE_RANDOM, 0, 5});
+  randomPermutation(again, n, {SHUFFLE_RANDOM, 0, 5});
+  randomPermutation(other, n, {SHUFFLE_RANDOM, 0, 6});
+  CHECK(first == again);
+  CHECK(first != other);
+
+  std::vector<int64_t> sorted(first);
+  std::sort(sorted.begin(), sorted.end());
+  for (int64_t i = 0; i < n; i++) {
+    CHECK(sorted[i] == i);
+  }
+
+  // the same on every rank
+  std::vector<int64_t> root(first);
+  MPI_Bcast(root.data(), n, MPI_INT64_T, 0, MPI_COMM_WORLD);
+  CHECK(root == first);
+}
+
+// the masks are the words of one stream per layer and rank, in element
+// order, whatever the way forward splits and draws them
+void testDropoutMask() {
+  const float p = 0.3f;
+  Layers::Dropout dropout(p);
+  // not a multiple of 64 elements, so the last mask word is partial
+  const Eigen::MatrixXf x = Eigen::MatrixXf::Constant(37, 29, 2.f);
+  const Eigen::MatrixXf dout = Eigen::MatrixXf::Constant(37, 29, 3.f);
+  const int rank = globalController().mpiRank();
+  const uint64_t threshold =
+      static_cast<uint64_t>(static_cast<double>(p) * 4294967296.0);
+  const float scale = 1.f / (1.f - p);
+
+  for (uint32_t step = 0; step < 2; step++) {
+    Eigen::MatrixXf out, din;
+    dropout.forward(out, x);
+    dropout.backward(din, dout);
+
+    std::vector<uint32_t> bits((x.size() + 3) / 4 * 4);
+    randomBits({DROPOUT_RANDOM, static_cast<uint32_t>(rank), step}, 0,
+               bits.size() / 4, bits.data());
+    Eigen::Index kept = 0;
+    for (Eigen::Index i = 0; i < x.size(); i++) {
+      const bool keep = bits[i] >= threshold;
+      kept += keep;
+      CHECK(out.data()[i] == (keep ? 2.f * scale : 0.f));
+      CHECK(din.data()[i] == (keep ? 3.f * scale : 0.f));
+    }
+    CHECK(kept > 0 && kept < x.size());
+    // only the bitmask is kept for backward
+    CHECK(dropout.getSavedActivationBytes() ==
+          (x.size() + 63) / 64 * sizeof(uint64_t));
+  }
+}
+} // namespace
+
+int main() {
+  // initializes MPI
+  globalController();
+  testPhiloxKnownAnswers();
+  testRandomBitsRanges();
+  testRandomPermutation();
+  testDropoutMask();
+  return 0;
+}
@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// PicoPebble - A lightweight distributed machine learning training framework for beginners
+//
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2024. All rights reserved.
+//
+// Licensed under the MIT License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+///////////////////////////////////////////////////////////////////////////
+/**
+ * Minimal checks shared by the tests
+ */
+
+#pragma once
+
+#include "GlobalState.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace DeepLearningFramework {
+namespace Tests {
+/**
+ * Each test is an MPI program: every rank runs the checks, and the first
+ * failing one prints where it failed and aborts all ranks, which makes
+ * ctest report the test as failed.
+ */
+inline void check(bool condition, const char *what, const char *file,
+                  int line) {
+  if (condition) {
+    return;
+  }
+  std::cerr << "Rank " << globalController().mpiRank() << ", " << file
+            << ":" << line << ": check failed: " << what << std::endl;
+  MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+/* |a - b| <= tolerance * max(1, |a|, |b|) */
+inline bool near(double a, double b, double tolerance) {
+  const double scale = std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+  return std::fabs(a - b) <= tolerance * scale;
+}
+}; // namespace Tests
+}; // namespace DeepLearningFramework
+
+#define CHECK(condition)                                                    \
+  DeepLearningFramework::Tests::check((condition), #condition, __FILE__,    \
+                                      __LINE__)